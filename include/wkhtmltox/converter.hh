@@ -34,6 +34,12 @@ class DLL_LOCAL ConverterPrivate;
 class DLL_PUBLIC Converter: public QObject {
     Q_OBJECT
 public:
+	//! Error codes reported by httpErrorCode when a conversion was stopped
+	enum StopErrorCode {
+		CanceledErrorCode = 2000,
+		DeadlineErrorCode = 2001
+	};
+
 	virtual ~Converter() {};
 
     int currentPhase();
@@ -41,12 +47,14 @@ public:
     QString phaseDescription(int phase=-1);
     QString progressString();
     int httpErrorCode();
+	void setStreamOutput(bool stream);
 signals:
     void warning(const QString & message);
     void error(const QString & message);
     void phaseChanged();
     void progressChanged(int progress);
     void finished(bool ok);
+	void outputChunk(const QByteArray & data);
 
 	void checkboxSvgChanged(const QString & path);
 	void checkboxCheckedSvgChanged(const QString & path);
@@ -30,8 +30,10 @@ typedef struct wkhtmltoimage_converter wkhtmltoimage_converter;
 typedef void (*wkhtmltoimage_str_callback)(wkhtmltoimage_converter * converter, const char * str);
 typedef void (*wkhtmltoimage_int_callback)(wkhtmltoimage_converter * converter, const int val);
 typedef void (*wkhtmltoimage_void_callback)(wkhtmltoimage_converter * converter);
+typedef void (*wkhtmltoimage_output_callback)(wkhtmltoimage_converter * converter, const unsigned char * data, long size, void * userdata);
 
 CAPI(int) wkhtmltoimage_init(int use_graphics);
+CAPI(int) wkhtmltoimage_init_threaded(int use_graphics);
 CAPI(int) wkhtmltoimage_deinit();
 CAPI(int) wkhtmltoimage_extended_qt();
 CAPI(const char *)wkhtmltoimage_version();
@@ -49,9 +51,16 @@ CAPI(void) wkhtmltoimage_set_error_callback(wkhtmltoimage_converter * converter,
 CAPI(void) wkhtmltoimage_set_phase_changed_callback(wkhtmltoimage_converter * converter, wkhtmltoimage_void_callback cb);
 CAPI(void) wkhtmltoimage_set_progress_changed_callback(wkhtmltoimage_converter * converter, wkhtmltoimage_int_callback cb);
 CAPI(void) wkhtmltoimage_set_finished_callback(wkhtmltoimage_converter * converter, wkhtmltoimage_int_callback cb);
+CAPI(void) wkhtmltoimage_set_output_callback(wkhtmltoimage_converter * converter, wkhtmltoimage_output_callback cb, void * userdata);
 CAPI(int) wkhtmltoimage_convert(wkhtmltoimage_converter * converter);
-/* CAPI(void) wkhtmltoimage_begin_conversion(wkhtmltoimage_converter * converter); */
-/* CAPI(void) wkhtmltoimage_cancel(wkhtmltoimage_converter * converter); */
+CAPI(void) wkhtmltoimage_begin_conversion(wkhtmltoimage_converter * converter);
+CAPI(void) wkhtmltoimage_cancel(wkhtmltoimage_converter * converter);
+CAPI(void) wkhtmltoimage_process_events(int timeout);
+CAPI(void) wkhtmltoimage_memory_cache_statistics(long long * hits, long long * misses, long long * bytes);
+CAPI(void) wkhtmltoimage_request_statistics(long long * requests, long long * queued_ms, long long * max_queued_ms);
+CAPI(void) wkhtmltoimage_image_statistics(long long * images, long long * decoded_bytes_saved);
+CAPI(void) wkhtmltoimage_register_blob(const char * url, const unsigned char * data, long length, const char * mime_type);
+CAPI(void) wkhtmltoimage_clear_blobs();
 
 CAPI(int) wkhtmltoimage_current_phase(wkhtmltoimage_converter * converter);
 CAPI(int) wkhtmltoimage_phase_count(wkhtmltoimage_converter * converter);
@@ -40,6 +40,7 @@ public:
 	~PdfConverter();
 	int pageCount();
 	void addResource(const settings::PdfObject & pageSettings, const QString * data=0);
+	void addResource(const settings::PdfObject & pageSettings, const QByteArray & data, const QUrl & baseUrl);
 	const settings::PdfGlobal & globalSettings() const;
 	const QByteArray & output();
     static const qreal millimeterToPointMultiplier;
@@ -0,0 +1,72 @@
+#!/usr/bin/python
+#
+# Copyright 2014 wkhtmltopdf authors
+#
+# This file is part of wkhtmltopdf.
+#
+# wkhtmltopdf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# wkhtmltopdf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with wkhtmltopdf.  If not, see <http:#www.gnu.org/licenses/>.
+
+# Send a conversion to a wkhtmltopdf or wkhtmltoimage started with --server
+#
+#   conversion-client.py <socket> <output> [name=value ...] [object name=value ...]
+#
+# Settings before the first "object" argument are global, the ones after an
+# "object" argument belong to that object. The output is written to <output>,
+# or to stdout when it is "-". Warnings and errors go to stderr, and the exit
+# code is 0 on success, 1 when the conversion failed and 2 on usage errors.
+
+from sys import argv, exit, stdout, stderr
+import socket
+
+def send(path, settings):
+	s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+	s.connect(path)
+	s.sendall(("\n".join(settings) + "\n\n").encode("utf-8"))
+	return s.makefile("rb")
+
+def receive(reply, out):
+	while True:
+		line = reply.readline()
+		if not line:
+			stderr.write("The server closed the connection\n")
+			return False
+		line = line.decode("utf-8").rstrip("\r\n")
+		kind, _, rest = line.partition(" ")
+		if kind == "data":
+			size = int(rest)
+			data = reply.read(size)
+			if len(data) != size:
+				stderr.write("The server closed the connection\n")
+				return False
+			out.write(data)
+		elif kind in ("warning", "error"):
+			stderr.write("%s: %s\n" % (kind.capitalize(), rest))
+		elif kind == "done":
+			success, code = rest.split(" ")
+			if code != "0":
+				stderr.write("Http error code: %s\n" % code)
+			return success == "1"
+
+if len(argv) < 3:
+	stderr.write("Usage: %s <socket> <output> [name=value ...] [object name=value ...]\n" % argv[0])
+	exit(2)
+
+reply = send(argv[1], argv[3:])
+if argv[2] == "-":
+	out = getattr(stdout, "buffer", stdout)
+else:
+	out = open(argv[2], "wb")
+ok = receive(reply, out)
+out.flush()
+exit(0 if ok else 1)
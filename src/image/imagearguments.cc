@@ -23,7 +23,7 @@
 #include <qglobal.h>
 
 ImageCommandLineParser::ImageCommandLineParser(wkhtmltopdf::settings::ImageGlobal & s):
-	settings(s) {
+	settings(s), serverWorkers(0), serverMaxJobs(0), serverMaxMemory(0) {
 	mode(global);
 	section("General Options");
 	addDocArgs();
@@ -43,6 +43,10 @@ ImageCommandLineParser::ImageCommandLineParser(wkhtmltopdf::settings::ImageGloba
 	addarg("crop-h",0,"Set height for cropping", new IntSetter(s.crop.height,"int"));
 	addarg("format",'f',"Output file format", new QStrSetter(s.fmt, "format") );
 	addarg("quality",0,"Output image quality (between 0 and 100)", new IntSetter(s.quality, "int") );
+	addarg("server", 0, "Run the conversions sent to a unix socket", new QStrSetter(server, "path") );
+	addarg("server-workers", 0, "Number of worker processes serving --server", new IntSetter(serverWorkers, "number") );
+	addarg("server-max-jobs", 0, "Replace a server worker after it has run this many jobs", new IntSetter(serverMaxJobs, "number") );
+	addarg("server-max-memory", 0, "Replace a server worker once it uses more than this many megabytes", new IntSetter(serverMaxMemory, "number") );
 
 	extended(true);
 	qthack(true);
@@ -37,6 +37,7 @@ void ImageCommandLineParser::manpage(FILE * fd) const {
  	outputSynopsis(o);
  	outputDescripton(o);
 	outputSwitches(o, true, false);
+	outputServerDoc(o);
  	outputContact(o);
 	outputAuthors(o);
 	delete o;
@@ -55,6 +56,7 @@ void ImageCommandLineParser::usage(FILE * fd, bool extended) const {
 	outputSwitches(o, extended, false);
 	if (extended) {
 		outputProxyDoc(o);
+		outputServerDoc(o);
 	}
  	outputContact(o);
 	delete o;
@@ -74,6 +76,7 @@ void ImageCommandLineParser::readme(FILE * fd, bool html) const {
 	outputSynopsis(o);
 	outputSwitches(o, true, true);
  	outputProxyDoc(o);
+	outputServerDoc(o);
 	outputStaticProblems(o);
 	outputCompilation(o);
 	outputInstallation(o);
@@ -123,6 +126,9 @@ void ImageCommandLineParser::parseArguments(int argc, const char ** argv, bool f
 		}
 	}
 
+	//The input and output are given by the jobs sent to the server
+	if (!server.isEmpty()) return;
+
 	if (final || settings.in=="" || settings.out=="") {
         fprintf(stderr, "You need to specify at least one input file, and exactly one output file\nUse - for stdin or stdout\n\n");
         usage(stderr, false);
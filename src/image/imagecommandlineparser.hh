@@ -30,6 +30,10 @@ class ImageCommandLineParser: public CommandLineParserBase {
 public:
 	const static int global = 1;
 	wkhtmltopdf::settings::ImageGlobal & settings;
+	QString server;
+	int serverWorkers;
+	int serverMaxJobs;
+	int serverMaxMemory;
 
 	//arguments.cc
 	ImageCommandLineParser(wkhtmltopdf::settings::ImageGlobal & settings);
@@ -18,6 +18,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
 
+#include "conversionserver.hh"
 #include "imagecommandlineparser.hh"
 #include "progressfeedback.hh"
 #include <QApplication>
@@ -26,6 +27,35 @@
 #include <wkhtmltox/imagesettings.hh>
 #include <wkhtmltox/utilities.hh>
 
+/*!
+  \brief Run the image conversions sent to --server
+*/
+class ImageConversionServer: public wkhtmltopdf::ConversionServer {
+public:
+	ImageConversionServer(const QString & path, const wkhtmltopdf::settings::ImageGlobal & d, MyLooksStyle * s):
+		ConversionServer(path), defaults(d), style(s) {}
+protected:
+	wkhtmltopdf::settings::ImageGlobal defaults;
+	MyLooksStyle * style;
+
+	virtual void convert(const wkhtmltopdf::ServerJob & job) {
+		wkhtmltopdf::settings::ImageGlobal settings = defaults;
+		//The output goes back over the socket
+		settings.out.clear();
+		if (!apply(settings, job.global)) {
+			finish(false, 0);
+			return;
+		}
+
+		wkhtmltopdf::ImageConverter converter(settings);
+		QObject::connect(&converter, SIGNAL(checkboxSvgChanged(const QString &)), style, SLOT(setCheckboxSvg(const QString &)));
+		QObject::connect(&converter, SIGNAL(checkboxCheckedSvgChanged(const QString &)), style, SLOT(setCheckboxCheckedSvg(const QString &)));
+		QObject::connect(&converter, SIGNAL(radiobuttonSvgChanged(const QString &)), style, SLOT(setRadioButtonSvg(const QString &)));
+		QObject::connect(&converter, SIGNAL(radiobuttonCheckedSvgChanged(const QString &)), style, SLOT(setRadioButtonCheckedSvg(const QString &)));
+		run(converter);
+	}
+};
+
 int main(int argc, char** argv) {
 	//This will store all our settings
 	wkhtmltopdf::settings::ImageGlobal settings;
@@ -35,6 +65,13 @@ int main(int argc, char** argv) {
 	parser.parseArguments(argc, (const char**)argv);
 
 
+	//The server is set up, and its workers forked, before Qt is
+	int listener = -1;
+	if (!parser.server.isEmpty()) {
+		listener = wkhtmltopdf::ConversionServer::start(parser.server, parser.serverWorkers);
+		if (listener == -1) return EXIT_FAILURE;
+	}
+
 	bool use_graphics=true;
 #if defined(Q_WS_X11) || defined(Q_WS_MACX)
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
@@ -46,6 +83,12 @@ int main(int argc, char** argv) {
 	MyLooksStyle * style = new MyLooksStyle();
 	a.setStyle(style);
 
+	if (listener != -1) {
+		ImageConversionServer server(parser.server, settings, style);
+		server.setWorkers(parser.serverWorkers, parser.serverMaxJobs, parser.serverMaxMemory);
+		return server.exec(listener);
+	}
+
 	//Create the actual page converter to convert the pages
 	wkhtmltopdf::ImageConverter converter(settings);
 	QObject::connect(&converter, SIGNAL(checkboxSvgChanged(const QString &)), style, SLOT(setCheckboxSvg(const QString &)));
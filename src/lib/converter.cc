@@ -30,6 +30,13 @@
 #include <qapplication.h>
 namespace wkhtmltopdf {
 
+ConverterPrivate::ConverterPrivate():
+	streamOutput(false), jobTimeout(0), phaseTimeout(0), printing(false), stopCode(0) {
+	jobTimer.setSingleShot(true);
+	phaseTimer.setSingleShot(true);
+	connect(&jobTimer, SIGNAL(timeout()), this, SLOT(jobTimedOut()));
+	connect(&phaseTimer, SIGNAL(timeout()), this, SLOT(phaseTimedOut()));
+}
 
 void ConverterPrivate::updateWebSettings(QWebSettings * ws, const settings::Web & s) const {
 #ifdef  __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
@@ -57,9 +64,92 @@ void ConverterPrivate::updateWebSettings(QWebSettings * ws, const settings::Web
 void ConverterPrivate::fail() {
 	error = true;
 	convertionDone = true;
+	stopTimers();
 	clearResources();
 	emit outer().finished(false);
-	qApp->exit(0); // quit qt's event handling
+}
+
+/*!
+ * Start the deadlines of a conversion that is about to begin
+ * \param s The settings holding the job and phase timeouts
+ */
+void ConverterPrivate::startTimers(const settings::LoadGlobal & s) {
+	connect(&outer(), SIGNAL(phaseChanged()), this, SLOT(restartPhaseTimer()), Qt::UniqueConnection);
+	connect(&outer(), SIGNAL(finished(bool)), this, SLOT(stopTimers()), Qt::UniqueConnection);
+	jobTimeout = s.jobTimeout;
+	phaseTimeout = s.phaseTimeout;
+	printing = false;
+	stopCode = 0;
+	cancelRequested.fetchAndStoreOrdered(0);
+	jobClock.start();
+	if (jobTimeout > 0) jobTimer.start(jobTimeout);
+	restartPhaseTimer();
+}
+
+void ConverterPrivate::restartPhaseTimer() {
+	phaseClock.start();
+	if (phaseTimeout > 0 && !convertionDone) phaseTimer.start(phaseTimeout);
+}
+
+void ConverterPrivate::stopTimers() {
+	jobTimer.stop();
+	phaseTimer.stop();
+}
+
+void ConverterPrivate::jobTimedOut() {
+	stop(Converter::DeadlineErrorCode, QString("Conversion did not finish within %1 ms").arg(jobTimeout));
+}
+
+void ConverterPrivate::phaseTimedOut() {
+	QString phase = currentPhase >= 0 && currentPhase < phaseDescriptions.size() ? phaseDescriptions[currentPhase] : QString();
+	stop(Converter::DeadlineErrorCode, QString("Phase \"%1\" did not finish within %2 ms").arg(phase).arg(phaseTimeout));
+}
+
+/*!
+ * Stop a running conversion, aborting everything in flight, and fail it
+ *
+ * While the document is printed the pages being printed may not be freed,
+ * so the stop is only recorded, and carried out by endPrinting.
+ * \param code The error code to report through httpErrorCode
+ * \param message The error to report
+ */
+void ConverterPrivate::stop(int code, const QString & message) {
+	if (convertionDone) return;
+	if (printing) {
+		if (stopCode == 0) {
+			stopCode = code;
+			stopMessage = message;
+		}
+		return;
+	}
+	errorCode = code;
+	emit outer().error(message);
+	fail();
+}
+
+/*!
+ * Called by the printing loops between pages, to see if they should stop
+ * \returns True if the conversion has been canceled or is past a deadline
+ */
+bool ConverterPrivate::stopPending() {
+	if (cancelRequested.testAndSetOrdered(1, 0))
+		stop(Converter::CanceledErrorCode, "Conversion canceled");
+	if (jobTimeout > 0 && jobClock.elapsed() >= jobTimeout) jobTimedOut();
+	if (phaseTimeout > 0 && phaseClock.elapsed() >= phaseTimeout) phaseTimedOut();
+	return stopCode != 0;
+}
+
+/*!
+ * Leave printing, carrying out a stop recorded meanwhile
+ * \returns True if the conversion was stopped
+ */
+bool ConverterPrivate::endPrinting() {
+	printing = false;
+	if (stopCode == 0) return false;
+	int code = stopCode;
+	stopCode = 0;
+	stop(code, stopMessage);
+	return true;
 }
 
 /*!
@@ -71,6 +161,14 @@ void ConverterPrivate::loadProgress(int progress) {
 	emit outer().progressChanged(progress);
 }
 
+/*!
+ * Hand a chunk of the output document to the outputChunk signal
+ * \param data The next bytes of the output
+ */
+void ConverterPrivate::emitOutput(const QByteArray & data) {
+	emit outer().outputChunk(data);
+}
+
 void ConverterPrivate::forwardError(QString error) {
 	emit outer().error(error);
 }
@@ -79,8 +177,12 @@ void ConverterPrivate::forwardWarning(QString warning) {
 	emit outer().warning(warning);
 }
 
+/*!
+ * Carry out a cancel requested by Converter::cancel
+ */
 void ConverterPrivate::cancel() {
-	error=true;
+	if (cancelRequested.testAndSetOrdered(1, 0))
+		stop(Converter::CanceledErrorCode, "Conversion canceled");
 }
 
 bool ConverterPrivate::convert() {
@@ -92,6 +194,25 @@ bool ConverterPrivate::convert() {
 }
 
 
+/*!
+  \class OutputStreamDevice
+  \brief Write only device passing everything written to it on as output chunks
+*/
+OutputStreamDevice::OutputStreamDevice(ConverterPrivate & c): converter(c) {}
+
+bool OutputStreamDevice::isSequential() const {
+	return true;
+}
+
+qint64 OutputStreamDevice::readData(char *, qint64) {
+	return -1;
+}
+
+qint64 OutputStreamDevice::writeData(const char * data, qint64 size) {
+	converter.emitOutput(QByteArray(data, int(size)));
+	return size;
+}
+
 /*!
   \brief Count the number of phases that the conversion process goes though
 */
@@ -130,11 +251,23 @@ int Converter::httpErrorCode() {
 	return priv().errorCode;
 }
 
+/*!
+  \brief Stream the output document instead of buffering it
+
+  When enabled and no output file is set, the output is handed to the
+  outputChunk signal while it is produced, and output() stays empty.
+  \param stream Should the output be streamed
+*/
+void Converter::setStreamOutput(bool stream) {
+	priv().streamOutput = stream;
+}
+
 /*!
   \brief Start a asynchronous conversion of html pages to a pdf document.
   Once conversion is done an finished signal will be emitted
 */
 void Converter::beginConvertion() {
+	priv().convertionDone = false;
 	priv().beginConvert();
 }
 
@@ -147,9 +280,16 @@ bool Converter::convert() {
 
 /*!
   \brief Cancel a running conversion
+
+  Loading is stopped, requests in flight are aborted and the conversion
+  fails with httpErrorCode() set to CanceledErrorCode. This may be called
+  from any thread, and from the slots connected to the converter. The
+  conversion is stopped once control is back in the event loop, or at the
+  next page when the document is being printed.
 */
 void Converter::cancel() {
-	priv().cancel();
+	priv().cancelRequested.fetchAndStoreOrdered(1);
+	QMetaObject::invokeMethod(&priv(), "cancel", Qt::QueuedConnection);
 }
 
 void Converter::emitCheckboxSvgs(const settings::LoadPage & ls) {
@@ -28,7 +28,11 @@
 
 #include "converter.hh"
 #include "websettings.hh"
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QIODevice>
+#include <QTimer>
 #include <QWebSettings>
 
 #include "dllbegin.inc"
@@ -38,12 +42,16 @@ namespace wkhtmltopdf {
 class DLL_LOCAL ConverterPrivate: public QObject {
 	Q_OBJECT
 public:
+	ConverterPrivate();
 	void copyFile(QFile & src, QFile & dst);
 
 	QList<QString> phaseDescriptions;
 	int currentPhase;
 
 	QString progressString;
+
+	bool streamOutput;
+	void emitOutput(const QByteArray & data);
 protected:
 	bool error;
 	virtual void clearResources() = 0;
@@ -52,9 +60,32 @@ protected:
 
 	bool convertionDone;
 
+	QTimer jobTimer;
+	QTimer phaseTimer;
+	int jobTimeout;
+	int phaseTimeout;
+	//The timers can not fire while printing, so the deadlines are also checked against these
+	QElapsedTimer jobClock;
+	QElapsedTimer phaseClock;
+	//Is the document being printed, nothing may be freed until it is done
+	bool printing;
+	//Stop recorded while printing, carried out once printing is done
+	int stopCode;
+	QString stopMessage;
+	//Set by Converter::cancel, from any thread
+	QAtomicInt cancelRequested;
+
 	void updateWebSettings(QWebSettings * ws, const settings::Web & s) const;
+	void startTimers(const settings::LoadGlobal & s);
+	void stop(int code, const QString & message);
+	bool stopPending();
+	bool endPrinting();
 public slots:
 	void fail();
+	void jobTimedOut();
+	void phaseTimedOut();
+	void restartPhaseTimer();
+	void stopTimers();
 	void loadProgress(int progress);
 
 	virtual void beginConvert() = 0;
@@ -66,6 +97,17 @@ private:
   friend class Converter;
 };
 
+class DLL_LOCAL OutputStreamDevice: public QIODevice {
+public:
+	OutputStreamDevice(ConverterPrivate & converter);
+	bool isSequential() const;
+protected:
+	qint64 readData(char * data, qint64 maxSize);
+	qint64 writeData(const char * data, qint64 size);
+private:
+	ConverterPrivate & converter;
+};
+
 }
 #include "dllend.inc"
 #endif //__CONVERTER_P_HH__
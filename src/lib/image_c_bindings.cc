@@ -27,6 +27,13 @@
  * - \b crop.width Width of the window to capture in pixels. E.g. "200"
  * - \b crop.height Height of the window to capture in pixels. E.g. "200"
  * - \b load.cookieJar Path of file used to load and store cookies.
+ * - \b load.memoryCacheSize Megabytes of downloaded resources to keep in memory, shared
+ *      by all conversions of the process, e.g. "64". The default "0" disables the cache.
+ *      Responses to requests carrying credentials are never cached.
+ * - \b load.jobTimeout Fail the conversion if it takes longer than this many milliseconds, e.g. "60000".
+ *      "0" disables the deadline.
+ * - \b load.phaseTimeout Fail the conversion if a single phase takes longer than this many
+ *      milliseconds. "0" disables the deadline.
  * - \b load.* Page specific settings related to loading content, see \ref pageLoad.
  * - \b web.* See \ref pageWeb.
  * - \b transparent When outputting a PNG or SVG, make the white background transparent.
@@ -49,6 +56,7 @@
 
 #include "image_c_bindings_p.hh"
 #include "pdf.h"
+#include "pdf_c_bindings_p.hh"
 
 #include "dllbegin.inc"
 using namespace wkhtmltopdf;
@@ -71,17 +79,24 @@ void MyImageConverter::progressChanged(int progress) {
 
 void MyImageConverter::finished(bool ok) {
 	if (finished_cb) (finished_cb)(reinterpret_cast<wkhtmltoimage_converter*>(this), ok);
+	succeeded = ok;
+	if (waiter) waiter->release();
+}
+
+void MyImageConverter::outputChunk(const QByteArray & data) {
+	if (output_cb) (output_cb)(reinterpret_cast<wkhtmltoimage_converter*>(this), (const unsigned char*)data.constData(), data.size(), output_userdata);
 }
 
 MyImageConverter::MyImageConverter(settings::ImageGlobal * gs, const QString * data):
 	warning_cb(0), error_cb(0), phase_changed(0), progress_changed(0), finished_cb(0),
-	converter(*gs, data), globalSettings(gs) {
+	output_cb(0), output_userdata(0), waiter(0), succeeded(false), converter(*gs, data), globalSettings(gs) {
 
     connect(&converter, SIGNAL(warning(const QString &)), this, SLOT(warning(const QString &)));
 	connect(&converter, SIGNAL(error(const QString &)), this, SLOT(error(const QString &)));
 	connect(&converter, SIGNAL(phaseChanged()), this, SLOT(phaseChanged()));
 	connect(&converter, SIGNAL(progressChanged(int)), this, SLOT(progressChanged(int)));
 	connect(&converter, SIGNAL(finished(bool)), this, SLOT(finished(bool)));
+	connect(&converter, SIGNAL(outputChunk(const QByteArray &)), this, SLOT(outputChunk(const QByteArray &)));
 }
 
 MyImageConverter::~MyImageConverter() {
@@ -100,6 +115,10 @@ CAPI(int) wkhtmltoimage_init(int use_graphics) {
 	return wkhtmltopdf_init(use_graphics);
 }
 
+CAPI(int) wkhtmltoimage_init_threaded(int use_graphics) {
+	return wkhtmltopdf_init_threaded(use_graphics);
+}
+
 CAPI(int) wkhtmltoimage_deinit() {
 	return wkhtmltopdf_deinit();
 }
@@ -119,14 +138,24 @@ CAPI(int) wkhtmltoimage_get_global_setting(wkhtmltoimage_global_settings * setti
 	return 1;
 }
 
+struct DLL_LOCAL CreateImageConverter: public RuntimeTask {
+	settings::ImageGlobal * settings;
+	QString data;
+	MyImageConverter * converter;
+	void run() {converter = new MyImageConverter(settings, &data);}
+};
+
 CAPI(wkhtmltoimage_converter *) wkhtmltoimage_create_converter(wkhtmltoimage_global_settings * settings, const char * data) {
-	QString str= QString::fromUtf8(data);
-	return reinterpret_cast<wkhtmltoimage_converter *>(
-		new MyImageConverter(reinterpret_cast<settings::ImageGlobal *>(settings), &str));
+	CreateImageConverter task;
+	task.settings = reinterpret_cast<settings::ImageGlobal *>(settings);
+	task.data = QString::fromUtf8(data);
+	runInRuntime(task);
+	return reinterpret_cast<wkhtmltoimage_converter *>(task.converter);
 }
 
 CAPI(void) wkhtmltoimage_destroy_converter(wkhtmltoimage_converter * converter) {
-	delete reinterpret_cast<MyImageConverter *>(converter);
+	//The converter lives on the thread running Qt, so it is deleted there
+	reinterpret_cast<MyImageConverter *>(converter)->deleteLater();
 }
 
 CAPI(void) wkhtmltoimage_set_warning_callback(wkhtmltoimage_converter * converter, wkhtmltoimage_str_callback cb) {
@@ -149,17 +178,49 @@ CAPI(void) wkhtmltoimage_set_finished_callback(wkhtmltoimage_converter * convert
 	reinterpret_cast<MyImageConverter *>(converter)->finished_cb = cb;
 }
 
-/*CAPI(void) wkhtmltoimage_begin_conversion(wkhtmltoimage_converter * converter) {
-	reinterpret_cast<MyImageConverter *>(converter)->converter.beginConversion();
-	}*/
+CAPI(void) wkhtmltoimage_set_output_callback(wkhtmltoimage_converter * converter, wkhtmltoimage_output_callback cb, void * userdata) {
+	MyImageConverter * conv = reinterpret_cast<MyImageConverter *>(converter);
+	conv->output_cb = cb;
+	conv->output_userdata = userdata;
+	conv->converter.setStreamOutput(cb != 0);
+}
+
+CAPI(void) wkhtmltoimage_begin_conversion(wkhtmltoimage_converter * converter) {
+	QMetaObject::invokeMethod(&reinterpret_cast<MyImageConverter *>(converter)->converter, "beginConvertion");
+}
+
+CAPI(void) wkhtmltoimage_process_events(int timeout) {
+	wkhtmltopdf_process_events(timeout);
+}
+
+CAPI(void) wkhtmltoimage_memory_cache_statistics(long long * hits, long long * misses, long long * bytes) {
+	wkhtmltopdf_memory_cache_statistics(hits, misses, bytes);
+}
+
+CAPI(void) wkhtmltoimage_request_statistics(long long * requests, long long * queued_ms, long long * max_queued_ms) {
+	wkhtmltopdf_request_statistics(requests, queued_ms, max_queued_ms);
+}
+
+CAPI(void) wkhtmltoimage_image_statistics(long long * images, long long * decoded_bytes_saved) {
+	wkhtmltopdf_image_statistics(images, decoded_bytes_saved);
+}
+
+CAPI(void) wkhtmltoimage_register_blob(const char * url, const unsigned char * data, long length, const char * mime_type) {
+	wkhtmltopdf_register_blob(url, data, length, mime_type);
+}
+
+CAPI(void) wkhtmltoimage_clear_blobs() {
+	wkhtmltopdf_clear_blobs();
+}
 
 CAPI(int) wkhtmltoimage_convert(wkhtmltoimage_converter * converter) {
-	return reinterpret_cast<MyImageConverter *>(converter)->converter.convert();
+	MyImageConverter * c = reinterpret_cast<MyImageConverter *>(converter);
+	return convertInRuntime(c, c->converter, c->waiter, c->succeeded);
 }
 
-/*CAPI(void) wkhtmltoimage_cancel(wkhtmltoimage_converter * converter) {
+CAPI(void) wkhtmltoimage_cancel(wkhtmltoimage_converter * converter) {
 	reinterpret_cast<MyImageConverter *>(converter)->converter.cancel();
-	}*/
+}
 
 CAPI(int) wkhtmltoimage_current_phase(wkhtmltoimage_converter * converter) {
 	return reinterpret_cast<MyImageConverter *>(converter)->converter.currentPhase();
@@ -29,6 +29,7 @@
 #include "image.h"
 #include "imageconverter.hh"
 #include <QObject>
+#include <QSemaphore>
 
 #include "dllbegin.inc"
 
@@ -40,6 +41,11 @@ public:
 	wkhtmltoimage_void_callback phase_changed;
 	wkhtmltoimage_int_callback progress_changed;
 	wkhtmltoimage_int_callback finished_cb;
+	wkhtmltoimage_output_callback output_cb;
+	void * output_userdata;
+	// released when the conversion has finished, while another thread waits for it
+	QSemaphore * waiter;
+	bool succeeded;
 
 	wkhtmltopdf::ImageConverter converter;
 
@@ -53,6 +59,7 @@ public slots:
     void phaseChanged();
     void progressChanged(int progress);
     void finished(bool ok);
+	void outputChunk(const QByteArray & data);
 private:
     MyImageConverter(const MyImageConverter&);
 };
@@ -64,6 +64,7 @@ void ImageConverterPrivate::beginConvert() {
 	convertionDone = false;
 	errorCode = 0;
 	progressString = "0%";
+	startTimers(settings.loadGlobal);
 	loaderObject = loader.addResource(settings.in, settings.loadPage, &inputData);
 	updateWebSettings(loaderObject->page.settings(), settings.web);
 	currentPhase=0;
@@ -144,11 +145,14 @@ void ImageConverterPrivate::pagesLoaded(bool ok) {
 	QImage image;
 	QFile file;
 	QBuffer buffer(&outputData);
+	OutputStreamDevice stream(*this);
 	QIODevice * dev = &file;
 
 	bool openOk=true;
 	// output image
-	if (settings.out.isEmpty())
+	if (settings.out.isEmpty() && streamOutput)
+		dev = &stream;
+	else if (settings.out.isEmpty())
 		dev =  &buffer;
 	else if (settings.out != "-" ) {
 		file.setFileName(settings.out);
@@ -223,8 +227,6 @@ void ImageConverterPrivate::pagesLoaded(bool ok) {
 	emit out.phaseChanged();
 	convertionDone = true;
 	emit out.finished(true);
-
-	qApp->exit(0); // quit qt's event handling
 }
 
 Converter & ImageConverterPrivate::outer() {
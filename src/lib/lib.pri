@@ -21,8 +21,9 @@ DEFINES += BUILDING_DLL
 PUBLIC_HEADERS += ../lib/converter.hh ../lib/multipageloader.hh ../lib/dllbegin.inc
 PUBLIC_HEADERS += ../lib/dllend.inc ../lib/loadsettings.hh ../lib/websettings.hh
 PUBLIC_HEADERS += ../lib/utilities.hh
-HEADERS += ../lib/multipageloader_p.hh  ../lib/converter_p.hh
+HEADERS += ../lib/multipageloader_p.hh  ../lib/converter_p.hh ../lib/memorycache.hh
 SOURCES += ../lib/loadsettings.cc ../lib/multipageloader.cc ../lib/tempfile.cc \
+	   ../lib/memorycache.cc \
 	   ../lib/converter.cc ../lib/websettings.cc  \
   	   ../lib/reflect.cc ../lib/utilities.cc
 
@@ -138,11 +138,21 @@ Proxy::Proxy():
 	password() {}
 
 LoadGlobal::LoadGlobal():
-	cookieJar("") {}
+	cookieJar(""),
+	memoryCacheSize(0),
+	jobTimeout(0),
+	phaseTimeout(0) {}
 
 LoadPage::LoadPage():
 	jsdelay(200),
 	windowStatus(""),
+	networkIdle(0),
+	waitForReady(false),
+	maxLoadWait(30000),
+	resourceTimeout(0),
+	hostConnections(6),
+	httpPipelining(false),
+	maxImageSize(0),
 	cacheDir(""),
 	zoomFactor(1.0),
 	repeatCustomHeaders(false),
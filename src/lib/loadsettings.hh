@@ -58,6 +58,15 @@ struct DLL_PUBLIC LoadGlobal {
 	LoadGlobal();
 	//! Path of the cookie jar file
 	QString cookieJar;
+
+	//! Size in megabytes of the process wide in memory resource cache, 0 disables it
+	int memoryCacheSize;
+
+	//! Fail the conversion if it takes longer than this many milliseconds, 0 to disable
+	int jobTimeout;
+
+	//! Fail the conversion if a single phase takes longer than this many milliseconds, 0 to disable
+	int phaseTimeout;
 };
 
 struct DLL_PUBLIC LoadPage {
@@ -81,6 +90,28 @@ struct DLL_PUBLIC LoadPage {
 	//! What window.status value should we wait for
 	QString windowStatus;
 
+	//! Consider the page done once no requests have been in flight for this many milliseconds, 0 to disable
+	int networkIdle;
+
+	//! Consider the page done once javascript calls window.wkhtmltopdfReady()
+	bool waitForReady;
+
+	//! The longest time in milliseconds to wait for the network to become idle or the page to be ready
+	int maxLoadWait;
+
+	//! Abort requests for resources taking longer than this many milliseconds, 0 to disable
+	int resourceTimeout;
+
+	//! Maximal number of requests in flight per host, 0 for no limit
+	int hostConnections;
+
+	//! Allow http pipelining of requests
+	bool httpPipelining;
+
+	//! Scale downloaded jpeg and png images down to at most this many pixels wide and high, 0 to disable.
+	//! Images the document gives no size are laid out at the smaller size
+	int maxImageSize;
+
 	//! What zoom factor should we apply when printing
 	// TODO MOVE
 	float zoomFactor;
@@ -124,6 +155,12 @@ struct DLL_PUBLIC LoadPage {
 	QString radiobuttonCheckedSvg;
 
 	QString cacheDir;
+
+	//! Hosts whose cached resources are used without revalidation
+	QList< QString > immutableHosts;
+
+	//! Url prefixes served from local directories instead of the network
+	QList< QPair<QString, QString> > urlMappings;
 	static QList<QString> mediaFilesExtensions;
 };
 
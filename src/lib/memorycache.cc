@@ -0,0 +1,218 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2014 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifdef __WKHTMLTOX_UNDEF_QT_DLL__
+#ifdef QT_DLL
+#undef QT_DLL
+#endif
+#endif
+
+#include "memorycache.hh"
+#include <QMutexLocker>
+#include <climits>
+
+namespace wkhtmltopdf {
+/*!
+  \file memorycache.hh
+  \brief Defines the MemoryCache and MemoryNetworkCache classes
+*/
+
+QMutex MemoryCache::mutex;
+QCache<QUrl, MemoryCache::Entry> MemoryCache::entries(0);
+qint64 MemoryCache::hits = 0;
+qint64 MemoryCache::misses = 0;
+
+/*!
+  \brief Decide if a response may be kept in the process wide cache
+
+  The cache is shared between conversions, so responses that are
+  specific to a user or a request are never stored.
+*/
+static bool shareable(const QNetworkCacheMetaData & metaData) {
+	if (!metaData.isValid() || !metaData.saveToDisk()) return false;
+	foreach (const QNetworkCacheMetaData::RawHeader & header, metaData.rawHeaders()) {
+		QByteArray name = header.first.toLower();
+		QByteArray value = header.second.toLower();
+		if (name == "cache-control" && (value.contains("private") || value.contains("no-store")))
+			return false;
+		if (name == "set-cookie") return false;
+		if (name == "vary" && value.trimmed() != "accept-encoding") return false;
+	}
+	return true;
+}
+
+/*!
+  \brief Set the byte budget of the cache, least recently used entries are evicted beyond it
+*/
+void MemoryCache::setMaxSize(qint64 bytes) {
+	QMutexLocker l(&mutex);
+	entries.setMaxCost(int(qMin(bytes, qint64(INT_MAX))));
+}
+
+/*!
+  \brief Look up a cached response
+  \param url The url of the response
+  \param entry Set to the cached response if there is one
+  \param count Should the lookup be counted as a hit or a miss
+*/
+bool MemoryCache::lookup(const QUrl & url, Entry & entry, bool count) {
+	QMutexLocker l(&mutex);
+	Entry * e = entries.object(url);
+	if (!e) {
+		if (count) ++misses;
+		return false;
+	}
+	if (count) ++hits;
+	entry = *e;
+	return true;
+}
+
+void MemoryCache::insert(const QNetworkCacheMetaData & metaData, const QByteArray & data) {
+	if (!shareable(metaData)) return;
+	QMutexLocker l(&mutex);
+	Entry * e = new Entry();
+	e->metaData = metaData;
+	e->data = data;
+	entries.insert(metaData.url(), e, data.size());
+}
+
+void MemoryCache::updateMetaData(const QNetworkCacheMetaData & metaData) {
+	QMutexLocker l(&mutex);
+	Entry * e = entries.object(metaData.url());
+	if (!e) return;
+	if (shareable(metaData))
+		e->metaData = metaData;
+	else
+		entries.remove(metaData.url());
+}
+
+bool MemoryCache::remove(const QUrl & url) {
+	QMutexLocker l(&mutex);
+	return entries.remove(url);
+}
+
+void MemoryCache::clear() {
+	QMutexLocker l(&mutex);
+	entries.clear();
+}
+
+/*!
+  \brief Read the counters of the cache
+  \param h Set to the number of lookups served from memory
+  \param m Set to the number of lookups not found in memory
+  \param bytes Set to the number of bytes currently held
+*/
+void MemoryCache::statistics(qint64 & h, qint64 & m, qint64 & bytes) {
+	QMutexLocker l(&mutex);
+	h = hits;
+	m = misses;
+	bytes = entries.totalCost();
+}
+
+/*!
+  \brief Construct a network cache backed by the process wide memory cache
+  \param f Cache consulted on memory misses and written through to, or NULL
+  \param parent The owner of the cache
+*/
+MemoryNetworkCache::MemoryNetworkCache(QAbstractNetworkCache * f, QObject * parent):
+	QAbstractNetworkCache(parent), fallback(f) {
+	if (fallback) fallback->setParent(this);
+}
+
+QNetworkCacheMetaData MemoryNetworkCache::metaData(const QUrl & url) {
+	MemoryCache::Entry entry;
+	if (MemoryCache::lookup(url, entry)) return entry.metaData;
+	if (!fallback) return QNetworkCacheMetaData();
+
+	//Promote responses found in the fallback cache to memory
+	QNetworkCacheMetaData metaData = fallback->metaData(url);
+	if (!metaData.isValid()) return metaData;
+	QIODevice * dev = fallback->data(url);
+	if (dev) {
+		MemoryCache::insert(metaData, dev->readAll());
+		delete dev;
+	}
+	return metaData;
+}
+
+void MemoryNetworkCache::updateMetaData(const QNetworkCacheMetaData & metaData) {
+	MemoryCache::updateMetaData(metaData);
+	if (fallback) fallback->updateMetaData(metaData);
+}
+
+QIODevice * MemoryNetworkCache::data(const QUrl & url) {
+	MemoryCache::Entry entry;
+	if (!MemoryCache::lookup(url, entry, false))
+		return fallback ? fallback->data(url) : 0;
+	QBuffer * buffer = new QBuffer();
+	buffer->setData(entry.data);
+	buffer->open(QIODevice::ReadOnly);
+	return buffer;
+}
+
+bool MemoryNetworkCache::remove(const QUrl & url) {
+	//Drop responses that were being stored when the download failed
+	foreach (QIODevice * device, pending.keys()) {
+		if (pending[device].url() != url) continue;
+		pending.remove(device);
+		delete device;
+	}
+	bool removed = MemoryCache::remove(url);
+	if (fallback && fallback->remove(url)) removed = true;
+	return removed;
+}
+
+qint64 MemoryNetworkCache::cacheSize() const {
+	qint64 hits, misses, bytes;
+	MemoryCache::statistics(hits, misses, bytes);
+	return bytes + (fallback ? fallback->cacheSize() : 0);
+}
+
+QIODevice * MemoryNetworkCache::prepare(const QNetworkCacheMetaData & metaData) {
+	if (!metaData.isValid() || !metaData.saveToDisk()) return 0;
+	QBuffer * buffer = new QBuffer();
+	buffer->open(QIODevice::WriteOnly);
+	pending[buffer] = metaData;
+	return buffer;
+}
+
+void MemoryNetworkCache::insert(QIODevice * device) {
+	if (!pending.contains(device)) return;
+	QNetworkCacheMetaData metaData = pending.take(device);
+	QByteArray data = static_cast<QBuffer *>(device)->data();
+	delete device;
+
+	MemoryCache::insert(metaData, data);
+	if (!fallback) return;
+	QIODevice * dev = fallback->prepare(metaData);
+	if (!dev) return;
+	dev->write(data);
+	fallback->insert(dev);
+}
+
+void MemoryNetworkCache::clear() {
+	foreach (QIODevice * device, pending.keys())
+		delete device;
+	pending.clear();
+	MemoryCache::clear();
+	if (fallback) fallback->clear();
+}
+
+}
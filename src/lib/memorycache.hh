@@ -0,0 +1,79 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2014 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __MEMORYCACHE_HH__
+#define __MEMORYCACHE_HH__
+#ifdef __WKHTMLTOX_UNDEF_QT_DLL__
+#ifdef QT_DLL
+#undef QT_DLL
+#endif
+#endif
+
+#include <QAbstractNetworkCache>
+#include <QBuffer>
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QNetworkCacheMetaData>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+
+class DLL_LOCAL MemoryCache {
+public:
+	struct Entry {
+		QNetworkCacheMetaData metaData;
+		QByteArray data;
+	};
+	static void setMaxSize(qint64 bytes);
+	static bool lookup(const QUrl & url, Entry & entry, bool count=true);
+	static void insert(const QNetworkCacheMetaData & metaData, const QByteArray & data);
+	static void updateMetaData(const QNetworkCacheMetaData & metaData);
+	static bool remove(const QUrl & url);
+	static void clear();
+	static void statistics(qint64 & h, qint64 & m, qint64 & bytes);
+private:
+	static QMutex mutex;
+	static QCache<QUrl, Entry> entries;
+	static qint64 hits;
+	static qint64 misses;
+};
+
+class DLL_LOCAL MemoryNetworkCache: public QAbstractNetworkCache {
+	Q_OBJECT
+private:
+	QAbstractNetworkCache * fallback;
+	QHash<QIODevice *, QNetworkCacheMetaData> pending;
+public:
+	MemoryNetworkCache(QAbstractNetworkCache * fallback, QObject * parent);
+	QNetworkCacheMetaData metaData(const QUrl & url);
+	void updateMetaData(const QNetworkCacheMetaData & metaData);
+	QIODevice * data(const QUrl & url);
+	bool remove(const QUrl & url);
+	qint64 cacheSize() const;
+	QIODevice * prepare(const QNetworkCacheMetaData & metaData);
+	void insert(QIODevice * device);
+public slots:
+	void clear();
+};
+
+}
+#include "dllend.inc"
+#endif //__MEMORYCACHE_HH__
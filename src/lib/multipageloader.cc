@@ -25,12 +25,18 @@
 #endif
 
 #include "multipageloader_p.hh"
+#include "memorycache.hh"
+#include <QBuffer>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutexLocker>
 #include <QNetworkCookie>
 #include <QNetworkDiskCache>
+#include <QStringList>
 #include <QTimer>
-#include <QUuid>
 #if QT_VERSION >= 0x050000
 #include <QUrlQuery>
 #endif
@@ -49,15 +55,680 @@ namespace wkhtmltopdf {
 
 LoaderObject::LoaderObject(QWebPage & p): page(p), skip(false) {};
 
+/*!
+  \brief Construct a network stack shared by the resources of a loader
+
+  Sharing a single QNetworkAccessManager lets resources reuse its
+  connection pool, dns cache and ssl sessions instead of opening
+  new connections for every page.
+  \param parent The owner of the network stack
+  \param h The maximal number of requests in flight per host, 0 for no limit
+*/
+SharedNetworkAccessManager::SharedNetworkAccessManager(QObject * parent, int h):
+	QNetworkAccessManager(parent), hostConnections(h) {
+	connect(this, SIGNAL(authenticationRequired(QNetworkReply*, QAuthenticator *)),
+	        this, SLOT(routeAuthenticationRequired(QNetworkReply *, QAuthenticator *)));
+	connect(this, SIGNAL(sslErrors(QNetworkReply*, const QList<QSslError>&)),
+	        this, SLOT(routeSslErrors(QNetworkReply*, const QList<QSslError>&)));
+	connect(this, SIGNAL(finished(QNetworkReply *)),
+	        this, SLOT(routeFinished(QNetworkReply *)));
+}
+
+/*!
+  \brief Fail the requests still queued or in flight, as they can not be sent any more
+*/
+SharedNetworkAccessManager::~SharedNetworkAccessManager() {
+	QList<InFlightRequest *> pending = queue + sent;
+	queue.clear();
+	sent.clear();
+	active.clear();
+	foreach (InFlightRequest * request, pending)
+		request->abandon();
+}
+
+QMutex SharedNetworkAccessManager::statisticsMutex;
+qint64 SharedNetworkAccessManager::scheduledRequests = 0;
+qint64 SharedNetworkAccessManager::queuedTime = 0;
+qint64 SharedNetworkAccessManager::maxQueuedTime = 0;
+qint64 SharedNetworkAccessManager::downscaledImages = 0;
+qint64 SharedNetworkAccessManager::decodedBytesSaved = 0;
+
+/*!
+  \brief Is content of the given type an image we know how to downscale
+*/
+static bool downscalable(const QString & contentType) {
+	QString type = contentType.section(';', 0, 0).trimmed().toLower();
+	return type == "image/jpeg" || type == "image/pjpeg" || type == "image/png";
+}
+
+/*!
+  \brief Scale an image down to fit in a square, before the page decodes it
+
+  JPEG images are decoded directly at the smaller size. PNG images are
+  decoded at full size and then scaled, as the PNG reader cannot decode
+  scaled, so they only save memory once the page decodes them. The
+  image is encoded again in its own format. Images that are small
+  enough, animated or that cannot be decoded are returned as is.
+  \param data The downloaded image
+  \param maxSize The largest width and height to keep
+*/
+QByteArray SharedNetworkAccessManager::downscaleImage(const QByteArray & data, int maxSize) {
+	QBuffer in;
+	in.setData(data);
+	in.open(QIODevice::ReadOnly);
+	QImageReader reader(&in);
+	QByteArray format = reader.format();
+	QSize size = reader.size();
+	if ((format != "jpeg" && format != "png") || !size.isValid() ||
+		(size.width() <= maxSize && size.height() <= maxSize) || reader.imageCount() > 1)
+		return data;
+
+	QSize scaled = size;
+	scaled.scale(maxSize, maxSize, Qt::KeepAspectRatio);
+	reader.setScaledSize(scaled);
+	QImage image = reader.read();
+	if (image.isNull()) return data;
+
+	QByteArray res;
+	QBuffer out(&res);
+	out.open(QIODevice::WriteOnly);
+	QImageWriter writer(&out, format);
+	if (format == "jpeg") writer.setQuality(95);
+	if (!writer.write(image)) return data;
+
+	QMutexLocker l(&statisticsMutex);
+	++downscaledImages;
+	decodedBytesSaved += (qint64(size.width()) * size.height() - qint64(scaled.width()) * scaled.height()) * 4;
+	return res;
+}
+
+/*!
+  \brief Read the counters of the images downscaled by all network stacks of the process
+  \param images Set to the number of images downscaled
+  \param saved Set to the number of bytes the decoded images no longer use
+*/
+void SharedNetworkAccessManager::imageStatistics(qint64 & images, qint64 & saved) {
+	QMutexLocker l(&statisticsMutex);
+	images = downscaledImages;
+	saved = decodedBytesSaved;
+}
+
+/*!
+  \brief Queue a request, to be sent once its host has a free connection
+
+  Requests are sent by priority, and in the order they were made within
+  a priority, so render blocking resources overtake images and media.
+*/
+void SharedNetworkAccessManager::schedule(InFlightRequest * request) {
+	int i = queue.size();
+	while (i > 0 && queue[i-1]->priority > request->priority) --i;
+	queue.insert(i, request);
+	dispatch();
+}
+
+/*!
+  \brief Remove a request that was never sent from the queue
+*/
+void SharedNetworkAccessManager::unschedule(InFlightRequest * request) {
+	queue.removeAll(request);
+}
+
+/*!
+  \brief Free the connection used by a request, and send the next ones
+*/
+void SharedNetworkAccessManager::release(InFlightRequest * request) {
+	sent.removeAll(request);
+	if (--active[request->host] <= 0) active.remove(request->host);
+	dispatch();
+}
+
+void SharedNetworkAccessManager::dispatch() {
+	for (int i=0; i < queue.size();) {
+		InFlightRequest * request = queue[i];
+		if (hostConnections > 0 && active.value(request->host) >= hostConnections) {
+			++i;
+			continue;
+		}
+		queue.removeAt(i);
+		sent.append(request);
+		++active[request->host];
+
+		qint64 waited = request->queued.elapsed();
+		statisticsMutex.lock();
+		++scheduledRequests;
+		queuedTime += waited;
+		maxQueuedTime = qMax(maxQueuedTime, waited);
+		statisticsMutex.unlock();
+
+		request->start();
+	}
+}
+
+/*!
+  \brief Read the queueing counters of all network stacks of the process
+  \param requests Set to the number of requests sent through the queue
+  \param queued Set to the total time in milliseconds requests waited in the queue
+  \param maxQueued Set to the longest time in milliseconds a request waited in the queue
+*/
+void SharedNetworkAccessManager::statistics(qint64 & requests, qint64 & queued, qint64 & maxQueued) {
+	QMutexLocker l(&statisticsMutex);
+	requests = scheduledRequests;
+	queued = queuedTime;
+	maxQueued = maxQueuedTime;
+}
+
+/*!
+  \brief Issue a request on behalf of a per resource access manager
+
+  The reply is reparented to the owner, so that signals about it can be
+  routed back to the resource that made the request.
+*/
+QNetworkReply * SharedNetworkAccessManager::forward(MyNetworkAccessManager * owner, Operation op, const QNetworkRequest & req, QIODevice * outgoingData) {
+	QNetworkReply * reply = createRequest(op, req, outgoingData);
+	reply->setParent(owner);
+	return reply;
+}
+
+/*!
+  \brief Post a multipart body, streaming its parts from their devices
+  \param owner The per resource access manager to deliver the reply to
+  \param req The request
+  \param body The body, which is deleted along with the reply
+*/
+QNetworkReply * SharedNetworkAccessManager::forward(MyNetworkAccessManager * owner, const QNetworkRequest & req, QHttpMultiPart * body) {
+	QNetworkReply * reply = post(req, body);
+	body->setParent(reply);
+	reply->setParent(owner);
+	return reply;
+}
+
+/*!
+  \brief Find the per resource access manager a reply belongs to
+
+  Coalesced requests are handled on behalf of the first resource still
+  waiting for them.
+*/
+static MyNetworkAccessManager * ownerOf(QNetworkReply * reply) {
+	InFlightRequest * request = qobject_cast<InFlightRequest *>(reply->parent());
+	if (request) return request->owner();
+	return qobject_cast<MyNetworkAccessManager *>(reply->parent());
+}
+
+void SharedNetworkAccessManager::routeAuthenticationRequired(QNetworkReply * reply, QAuthenticator * authenticator) {
+	MyNetworkAccessManager * owner = ownerOf(reply);
+	if (owner) owner->replyAuthenticationRequired(reply, authenticator);
+}
+
+void SharedNetworkAccessManager::routeSslErrors(QNetworkReply * reply, const QList<QSslError> & errors) {
+	MyNetworkAccessManager * owner = ownerOf(reply);
+	if (owner) owner->replySslErrors(reply, errors);
+}
+
+void SharedNetworkAccessManager::routeFinished(QNetworkReply * reply) {
+	//The replies handed out for a coalesced request report their own completion
+	if (qobject_cast<InFlightRequest *>(reply->parent())) return;
+	MyNetworkAccessManager * owner = ownerOf(reply);
+	if (owner) owner->replyFinished(reply);
+}
+
+/*!
+  \brief Construct a reply fed by a request shared with other resources
+  \param req The request the reply answers
+  \param s The shared request delivering the response
+  \param parent The per resource access manager that made the request
+*/
+CoalescedReply::CoalescedReply(const QNetworkRequest & req, InFlightRequest * s, QObject * parent):
+	QNetworkReply(parent), source(s), replayed(false) {
+	setRequest(req);
+	setUrl(req.url());
+	setOperation(QNetworkAccessManager::GetOperation);
+	open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+CoalescedReply::~CoalescedReply() {
+	if (source) source->detach(this);
+}
+
+void CoalescedReply::abort() {
+	if (!source) return;
+	source->detach(this);
+	source = 0;
+	setError(OperationCanceledError, "Operation canceled");
+	setFinished(true);
+	if (replayed) complete();
+}
+
+qint64 CoalescedReply::bytesAvailable() const {
+	return buffer.size() + QNetworkReply::bytesAvailable();
+}
+
+bool CoalescedReply::isSequential() const {
+	return true;
+}
+
+qint64 CoalescedReply::readData(char * data, qint64 maxSize) {
+	if (buffer.isEmpty()) return isFinished() ? -1 : 0;
+	qint64 len = qMin(maxSize, qint64(buffer.size()));
+	memcpy(data, buffer.constData(), len);
+	buffer.remove(0, len);
+	return len;
+}
+
+/*!
+  \brief Emit the signals for everything received before the reply was handed out
+*/
+void CoalescedReply::replay() {
+	replayed = true;
+	if (!rawHeaderList().isEmpty()) emit metaDataChanged();
+	if (!buffer.isEmpty()) emit readyRead();
+	if (isFinished()) complete();
+}
+
+void CoalescedReply::complete() {
+	if (error() != NoError) emit error(error());
+	emit finished();
+	MyNetworkAccessManager * owner = qobject_cast<MyNetworkAccessManager *>(parent());
+	if (owner) owner->replyFinished(this);
+}
+
+QHash<QString, InFlightRequest *> InFlightRequest::inFlight;
+
+/*!
+  \brief Classify a request by the kind of resource it is likely to fetch
+
+  WebKit does not tell what a request is for, so the accept header and
+  the extension of the url are used. Documents come first, then the
+  stylesheets and fonts blocking rendering, then scripts, other content,
+  images and finally media.
+*/
+static int requestPriority(const QNetworkRequest & req) {
+	static QHash<QString, int> priorities;
+	if (priorities.isEmpty()) {
+		priorities["html"] = priorities["htm"] = priorities["xhtml"] = 0;
+		priorities["css"] = 1;
+		priorities["woff"] = priorities["woff2"] = priorities["ttf"] = priorities["otf"] = priorities["eot"] = 2;
+		priorities["js"] = 3;
+		priorities["png"] = priorities["jpg"] = priorities["jpeg"] = priorities["gif"] = priorities["svg"] =
+			priorities["webp"] = priorities["bmp"] = priorities["ico"] = 5;
+		priorities["mp4"] = priorities["webm"] = priorities["ogg"] = priorities["mp3"] = priorities["wav"] = 6;
+	}
+	QString suffix = QFileInfo(req.url().path()).suffix().toLower();
+	if (priorities.contains(suffix)) return priorities[suffix];
+	QByteArray accept = req.rawHeader("Accept");
+	if (accept.startsWith("text/html") || accept.startsWith("application/xhtml")) return 0;
+	if (accept.startsWith("text/css")) return 1;
+	if (accept.startsWith("image/")) return 5;
+	return 4;
+}
+
+InFlightRequest::InFlightRequest(const QString & k, SharedNetworkAccessManager * n, const QNetworkRequest & req, int m):
+	key(k), nam(n), request(req), reply(0), metaDataReceived(false), maxImageSize(m), holding(false) {
+	priority = requestPriority(req);
+	host = QString("%1:%2").arg(req.url().host()).arg(req.url().port(req.url().scheme() == "https" ? 443 : 80));
+	queued.start();
+}
+
+/*!
+  \brief Send the request, once the scheduler of the network stack allows it
+*/
+void InFlightRequest::start() {
+	reply = nam->forward(owner(), QNetworkAccessManager::GetOperation, request, 0);
+	reply->setParent(this);
+	connect(reply, SIGNAL(metaDataChanged()), this, SLOT(metaDataChanged()));
+	connect(reply, SIGNAL(readyRead()), this, SLOT(readyRead()));
+	connect(reply, SIGNAL(finished()), this, SLOT(finished()));
+}
+
+/*!
+  \brief Stop sharing the request, and give its connection to the next one
+*/
+void InFlightRequest::unregister() {
+	if (!key.isEmpty() && inFlight.value(key) == this) inFlight.remove(key);
+	if (!nam) return;
+	if (reply)
+		nam->release(this);
+	else
+		nam->unschedule(this);
+}
+
+/*!
+  \brief Issue a GET request, sharing the download with identical requests in flight
+
+  Pages, headers and footers often reference the same stylesheets and
+  images, and are loaded at the same time. Requests for the same url,
+  with the same headers and cookies and through the same proxy, are
+  served by a single download whose response is copied to every reply.
+  Only requests made through the same network stack are shared, so a
+  download never outlives the stack sending it. Downloads are queued by
+  the scheduler of the network stack before they are sent.
+  \param nam The shared network stack to download with
+  \param owner The per resource access manager making the request
+  \param req The request
+  \param maxImageSize Largest size of the images delivered, 0 to deliver them as downloaded
+*/
+QNetworkReply * InFlightRequest::get(SharedNetworkAccessManager * nam, MyNetworkAccessManager * owner, const QNetworkRequest & req, int maxImageSize) {
+	QString scheme = req.url().scheme();
+	if (scheme != "http" && scheme != "https")
+		return nam->forward(owner, QNetworkAccessManager::GetOperation, req, 0);
+
+	//Reloads are scheduled, but never share a download. Requests carrying
+	//credentials are not saved to the cache and still share, as the key covers them
+	if (req.attribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferNetwork).toInt() == QNetworkRequest::AlwaysNetwork &&
+		req.attribute(QNetworkRequest::CacheSaveControlAttribute, true).toBool()) {
+		InFlightRequest * request = new InFlightRequest(QString(), nam, req, maxImageSize);
+		CoalescedReply * follower = new CoalescedReply(req, request, owner);
+		request->followers.append(follower);
+		QMetaObject::invokeMethod(follower, "replay", Qt::QueuedConnection);
+		nam->schedule(request);
+		return follower;
+	}
+
+	QStringList parts;
+	parts << QString::number(quintptr(nam), 16) << req.url().toString()
+		<< QString("%1:%2").arg(nam->proxy().hostName()).arg(nam->proxy().port())
+		<< QString::number(maxImageSize);
+	foreach (const QByteArray & name, req.rawHeaderList())
+		parts << QString::fromLatin1(name + ": " + req.rawHeader(name));
+	if (nam->cookieJar())
+		foreach (const QNetworkCookie & cookie, nam->cookieJar()->cookiesForUrl(req.url()))
+			parts << QString::fromLatin1(cookie.toRawForm(QNetworkCookie::NameAndValueOnly));
+	QString key = parts.join("\n");
+
+	InFlightRequest * request = inFlight.value(key);
+	bool created = !request;
+	if (created) {
+		request = new InFlightRequest(key, nam, req, maxImageSize);
+		inFlight[key] = request;
+	}
+	CoalescedReply * follower = new CoalescedReply(req, request, owner);
+	request->followers.append(follower);
+	request->copyMetaData(follower);
+	if (!request->holding) follower->buffer = request->received;
+	//Signals can only be emitted once the caller has connected to the reply
+	QMetaObject::invokeMethod(follower, "replay", Qt::QueuedConnection);
+	if (created) nam->schedule(request);
+	return follower;
+}
+
+/*!
+  \brief Get the per resource access manager of the first reply still waiting
+*/
+MyNetworkAccessManager * InFlightRequest::owner() const {
+	foreach (CoalescedReply * follower, followers) {
+		MyNetworkAccessManager * o = qobject_cast<MyNetworkAccessManager *>(follower->parent());
+		if (o) return o;
+	}
+	return 0;
+}
+
+/*!
+  \brief Stop delivering to a reply, the download is aborted once no reply waits for it
+*/
+void InFlightRequest::detach(CoalescedReply * follower) {
+	followers.removeAll(follower);
+	follower->source = 0;
+	if (!followers.isEmpty()) return;
+	unregister();
+	if (reply) {
+		reply->disconnect(this);
+		reply->abort();
+	}
+	deleteLater();
+}
+
+/*!
+  \brief Finish every waiting reply with an error, as the network stack is going away
+*/
+void InFlightRequest::abandon() {
+	if (!key.isEmpty() && inFlight.value(key) == this) inFlight.remove(key);
+	nam = 0;
+	//The reply has to go before the access manager that created it
+	if (reply) {
+		reply->disconnect(this);
+		reply->abort();
+		delete reply;
+		reply = 0;
+	}
+	QList<CoalescedReply *> waiting = followers;
+	followers.clear();
+	foreach (CoalescedReply * follower, waiting) {
+		follower->source = 0;
+		follower->setError(QNetworkReply::OperationCanceledError, "The network access manager was destroyed");
+		follower->setFinished(true);
+		if (follower->replayed) follower->complete();
+	}
+	deleteLater();
+}
+
+void InFlightRequest::copyMetaData(CoalescedReply * follower) {
+	if (!metaDataReceived) return;
+	static const QNetworkRequest::Attribute attributes[] = {
+		QNetworkRequest::HttpStatusCodeAttribute,
+		QNetworkRequest::HttpReasonPhraseAttribute,
+		QNetworkRequest::RedirectionTargetAttribute,
+		QNetworkRequest::ConnectionEncryptedAttribute,
+		QNetworkRequest::SourceIsFromCacheAttribute
+	};
+	for (uint i=0; i < sizeof(attributes) / sizeof(attributes[0]); ++i)
+		follower->setAttribute(attributes[i], reply->attribute(attributes[i]));
+	foreach (const QByteArray & name, reply->rawHeaderList())
+		follower->setRawHeader(name, reply->rawHeader(name));
+}
+
+void InFlightRequest::metaDataChanged() {
+	metaDataReceived = true;
+	holding = maxImageSize > 0 && downscalable(reply->header(QNetworkRequest::ContentTypeHeader).toString());
+	foreach (CoalescedReply * follower, followers) {
+		copyMetaData(follower);
+		if (follower->replayed) emit follower->metaDataChanged();
+	}
+}
+
+void InFlightRequest::readyRead() {
+	QByteArray data = reply->readAll();
+	received += data;
+	if (holding) return;
+	foreach (CoalescedReply * follower, followers) {
+		follower->buffer += data;
+		if (follower->replayed) emit follower->readyRead();
+	}
+}
+
+void InFlightRequest::finished() {
+	unregister();
+	metaDataReceived = true;
+	QByteArray data = reply->readAll();
+	//Held back images are delivered at once, scaled down if need be
+	if (holding) {
+		received += data;
+		data = received;
+		if (reply->error() == QNetworkReply::NoError)
+			data = SharedNetworkAccessManager::downscaleImage(data, maxImageSize);
+	}
+	QList<CoalescedReply *> waiting = followers;
+	followers.clear();
+	foreach (CoalescedReply * follower, waiting) {
+		copyMetaData(follower);
+		if (holding) follower->setHeader(QNetworkRequest::ContentLengthHeader, data.size());
+		follower->buffer += data;
+		follower->source = 0;
+		if (reply->error() != QNetworkReply::NoError)
+			follower->setError(reply->error(), reply->errorString());
+		follower->setFinished(true);
+		if (follower->replayed) {
+			if (!data.isEmpty()) emit follower->readyRead();
+			follower->complete();
+		}
+	}
+	deleteLater();
+}
+
+/*!
+  \brief Construct a reply serving content that is already in memory
+  \param req The request the reply answers
+  \param op The operation of the request
+  \param data The content of the reply
+  \param mimeType The mime type of the content
+  \param parent The per resource access manager that made the request
+*/
+StaticReply::StaticReply(const QNetworkRequest & req, QNetworkAccessManager::Operation op, const QByteArray & data, const QString & mimeType, QObject * parent):
+	QNetworkReply(parent) {
+	setRequest(req);
+	setUrl(req.url());
+	setOperation(op);
+	if (op == QNetworkAccessManager::GetOperation) content = data;
+	setHeader(QNetworkRequest::ContentTypeHeader, mimeType);
+	setHeader(QNetworkRequest::ContentLengthHeader, data.size());
+	setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+	setAttribute(QNetworkRequest::HttpReasonPhraseAttribute, "OK");
+	open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+	//Signals can only be emitted once the caller has connected to the reply
+	QMetaObject::invokeMethod(this, "deliver", Qt::QueuedConnection);
+}
+
+/*!
+  \brief Construct a reply reporting that the requested content does not exist
+*/
+StaticReply::StaticReply(const QNetworkRequest & req, QNetworkAccessManager::Operation op, QObject * parent):
+	QNetworkReply(parent) {
+	setRequest(req);
+	setUrl(req.url());
+	setOperation(op);
+	setError(ContentNotFoundError, QString("%1 not found in mapped directory").arg(req.url().toString()));
+	open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+	QMetaObject::invokeMethod(this, "deliver", Qt::QueuedConnection);
+}
+
+void StaticReply::abort() {}
+
+qint64 StaticReply::bytesAvailable() const {
+	return content.size() + QNetworkReply::bytesAvailable();
+}
+
+bool StaticReply::isSequential() const {
+	return true;
+}
+
+qint64 StaticReply::readData(char * data, qint64 maxSize) {
+	if (content.isEmpty()) return -1;
+	qint64 len = qMin(maxSize, qint64(content.size()));
+	memcpy(data, content.constData(), len);
+	content.remove(0, len);
+	return len;
+}
+
+void StaticReply::deliver() {
+	setFinished(true);
+	if (error() != NoError)
+		emit error(error());
+	else {
+		emit metaDataChanged();
+		if (!content.isEmpty()) emit readyRead();
+	}
+	emit finished();
+	MyNetworkAccessManager * owner = qobject_cast<MyNetworkAccessManager *>(parent());
+	if (owner) owner->replyFinished(this);
+}
+
+QMutex ResourceBlobs::mutex;
+QHash<QString, QPair<QByteArray, QString> > ResourceBlobs::blobs;
+
+/*!
+  \brief Register content to serve for a url instead of fetching it
+
+  Blobs are shared by all loaders of the process, and may be registered
+  from any thread.
+  \param url The url to serve the content for
+  \param data The content
+  \param mimeType The mime type of the content
+*/
+void ResourceBlobs::add(const QUrl & url, const QByteArray & data, const QString & mimeType) {
+	QMutexLocker l(&mutex);
+	blobs[url.toString(QUrl::RemoveFragment)] = qMakePair(data, mimeType);
+}
+
+void ResourceBlobs::clear() {
+	QMutexLocker l(&mutex);
+	blobs.clear();
+}
+
+bool ResourceBlobs::lookup(const QUrl & url, QByteArray & data, QString & mimeType) {
+	QMutexLocker l(&mutex);
+	QHash<QString, QPair<QByteArray, QString> >::const_iterator i = blobs.find(url.toString(QUrl::RemoveFragment));
+	if (i == blobs.end()) return false;
+	data = i->first;
+	mimeType = i->second;
+	return true;
+}
+
+/*!
+  \brief Escape a value for use in a quoted header parameter
+*/
+static QString escapeQuotes(QString value) {
+	return value.replace('\\', "\\\\").replace('"', "\\\"");
+}
+
+/*!
+  \brief Guess the mime type of a file served from a mapped directory
+*/
+static QString mimeTypeForFile(const QString & path) {
+	static QHash<QString, QString> types;
+	if (types.isEmpty()) {
+		types["html"] = types["htm"] = "text/html";
+		types["xhtml"] = "application/xhtml+xml";
+		types["css"] = "text/css";
+		types["js"] = "application/javascript";
+		types["json"] = "application/json";
+		types["xml"] = "text/xml";
+		types["txt"] = "text/plain";
+		types["png"] = "image/png";
+		types["jpg"] = types["jpeg"] = "image/jpeg";
+		types["gif"] = "image/gif";
+		types["svg"] = "image/svg+xml";
+		types["ico"] = "image/x-icon";
+		types["woff"] = "application/font-woff";
+		types["ttf"] = "application/x-font-ttf";
+		types["otf"] = "application/x-font-opentype";
+		types["eot"] = "application/vnd.ms-fontobject";
+	}
+	return types.value(QFileInfo(path).suffix().toLower(), "application/octet-stream");
+}
+
 MyNetworkAccessManager::MyNetworkAccessManager(const settings::LoadPage & s): 
 	disposed(false),
-	settings(s) {
+	settings(s) {}
 
-	if ( !s.cacheDir.isEmpty() ){
-		QNetworkDiskCache *cache = new QNetworkDiskCache(this);
-		cache->setCacheDirectory(s.cacheDir);
-		QNetworkAccessManager::setCache(cache);
-	}
+/*!
+  \brief Set the shared network stack requests are forwarded to
+*/
+void MyNetworkAccessManager::setShared(SharedNetworkAccessManager * s) {
+	shared = s;
+}
+
+/*!
+  \brief Set the body to send with the next post request
+
+  QWebFrame can only post a body held in memory, so multipart bodies
+  are handed to the access manager directly instead, and streamed from
+  disk when the page posts.
+  \param body The body, owned by the access manager from now on
+*/
+void MyNetworkAccessManager::setPostBody(QHttpMultiPart * body) {
+	if (postBody) delete postBody;
+	body->setParent(this);
+	postBody = body;
+}
+
+void MyNetworkAccessManager::replyAuthenticationRequired(QNetworkReply * reply, QAuthenticator * authenticator) {
+	emit authenticationRequired(reply, authenticator);
+}
+
+void MyNetworkAccessManager::replySslErrors(QNetworkReply * reply, const QList<QSslError> & errors) {
+	emit sslErrors(reply, errors);
+}
+
+void MyNetworkAccessManager::replyFinished(QNetworkReply * reply) {
+	emit finished(reply);
 }
 
 void MyNetworkAccessManager::dispose() {
@@ -70,7 +741,109 @@ void MyNetworkAccessManager::allow(QString path) {
 	allowed.insert(x);
 }
 
+/*!
+  \brief Serve a request from a registered blob or a mapped directory
+  \returns The reply, or NULL if the request should go to the network
+*/
+QNetworkReply * MyNetworkAccessManager::mappedReply(Operation op, const QNetworkRequest & req) {
+	if (op != GetOperation && op != HeadOperation) return 0;
+
+	QByteArray data;
+	QString mimeType;
+	if (ResourceBlobs::lookup(req.url(), data, mimeType)) {
+		if (settings.maxImageSize > 0 && downscalable(mimeType))
+			data = SharedNetworkAccessManager::downscaleImage(data, settings.maxImageSize);
+		return new StaticReply(req, op, data, mimeType, this);
+	}
+
+	QString url = req.url().toString(QUrl::RemoveFragment | QUrl::RemoveQuery);
+	typedef QPair<QString, QString> MT;
+	foreach (const MT & m, settings.urlMappings) {
+		if (m.first.isEmpty() || !url.startsWith(m.first)) continue;
+		QString root = QDir::cleanPath(QDir(m.second).absolutePath());
+		QString path = QDir::cleanPath(root + "/" + url.mid(m.first.size()));
+		//Never serve files outside the mapped directory
+		QFile file(path);
+		if (!path.startsWith(root + "/") || !file.open(QIODevice::ReadOnly)) {
+			emit warning(QString("Mapped url %1 not found at %2").arg(req.url().toString(), path));
+			return new StaticReply(req, op, this);
+		}
+		data = file.readAll();
+		mimeType = mimeTypeForFile(path);
+		if (settings.maxImageSize > 0 && downscalable(mimeType))
+			data = SharedNetworkAccessManager::downscaleImage(data, settings.maxImageSize);
+		return new StaticReply(req, op, data, mimeType, this);
+	}
+	return 0;
+}
+
+/*!
+  \brief Create a request, keeping track of the replies still in flight
+*/
 QNetworkReply * MyNetworkAccessManager::createRequest(Operation op, const QNetworkRequest & req, QIODevice * outgoingData) {
+	QNetworkReply * reply = route(op, req, outgoingData);
+	pending.insert(reply);
+	connect(reply, SIGNAL(finished()), this, SLOT(replyDone()));
+	connect(reply, SIGNAL(destroyed(QObject *)), this, SLOT(replyDestroyed(QObject *)));
+	if (settings.resourceTimeout > 0) {
+		//The timer is owned by the reply, so it goes away with it
+		QTimer * timer = new QTimer(reply);
+		timer->setSingleShot(true);
+		connect(timer, SIGNAL(timeout()), this, SLOT(replyTimedOut()));
+		timer->start(settings.resourceTimeout);
+	}
+	emit requestStarted();
+	return reply;
+}
+
+int MyNetworkAccessManager::pendingReplies() const {
+	return pending.size();
+}
+
+/*!
+  \brief Abort all replies still in flight
+*/
+void MyNetworkAccessManager::abortPending() {
+	foreach (QObject * o, pending.toList())
+		static_cast<QNetworkReply *>(o)->abort();
+}
+
+void MyNetworkAccessManager::replyTimedOut() {
+	QNetworkReply * reply = static_cast<QNetworkReply *>(sender()->parent());
+	if (reply->isFinished()) return;
+	emit warning(QString("Request for %1 aborted after %2 ms").arg(reply->url().toString()).arg(settings.resourceTimeout));
+	reply->abort();
+}
+
+void MyNetworkAccessManager::replyDone() {
+	replyDestroyed(sender());
+}
+
+void MyNetworkAccessManager::replyDestroyed(QObject * reply) {
+	if (!pending.remove(reply)) return;
+	if (pending.isEmpty()) emit idle();
+}
+
+void ReadyCallback::ready() {
+	emit called();
+}
+
+/*!
+  \brief Does a request carry credentials, whose response may not be shared
+
+  That is an Authorization or Cookie header, a custom header, cookies in
+  the cookie jar for its url, or a username to answer challenges with.
+*/
+bool MyNetworkAccessManager::carriesCredentials(const QNetworkRequest & req) const {
+	if (req.hasRawHeader("Authorization") || req.hasRawHeader("Cookie") || !settings.username.isEmpty())
+		return true;
+	typedef QPair<QString, QString> HT;
+	foreach (const HT & j, settings.customHeaders)
+		if (req.hasRawHeader(j.first.toLatin1())) return true;
+	return cookieJar() && !cookieJar()->cookiesForUrl(req.url()).isEmpty();
+}
+
+QNetworkReply * MyNetworkAccessManager::route(Operation op, const QNetworkRequest & req, QIODevice * outgoingData) {
 
 	if (disposed)
 	{
@@ -83,6 +856,9 @@ QNetworkReply * MyNetworkAccessManager::createRequest(Operation op, const QNetwo
 		return QNetworkAccessManager::createRequest(op, r2, outgoingData);
 	}
 
+	QNetworkReply * mapped = mappedReply(op, req);
+	if (mapped) return mapped;
+
 	if (req.url().scheme() == "file" && settings.blockLocalFileAccess) {
 		bool ok=false;
 		QString path = QFileInfo(req.url().toLocalFile()).canonicalFilePath();
@@ -108,6 +884,28 @@ QNetworkReply * MyNetworkAccessManager::createRequest(Operation op, const QNetwo
 		foreach (const HT & j, settings.customHeaders)
 			r3.setRawHeader(j.first.toLatin1(), j.second.toLatin1());
 	}
+	if (settings.httpPipelining)
+		r3.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+	//Resources from immutable hosts never change, so skip revalidating them
+	if (settings.immutableHosts.contains(r3.url().host()))
+		r3.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
+	//Responses to requests carrying credentials are private to this conversion,
+	//so keep them out of the caches shared with other conversions
+	if (carriesCredentials(r3)) {
+		r3.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+		r3.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+	}
+	if (shared && op == PostOperation && postBody) {
+		QHttpMultiPart * body = postBody;
+		postBody = 0;
+		//The content type, with its boundary, comes from the body
+		r3.setHeader(QNetworkRequest::ContentTypeHeader, QVariant());
+		return shared->forward(this, r3, body);
+	}
+	if (shared && op == GetOperation && !outgoingData)
+		return InFlightRequest::get(shared, this, r3, settings.maxImageSize);
+	if (shared)
+		return shared->forward(this, op, r3, outgoingData);
 	return QNetworkAccessManager::createRequest(op, r3, outgoingData);
 }
 
@@ -149,6 +947,8 @@ ResourceObject::ResourceObject(MultiPageLoaderPrivate & mpl, const QUrl & u, con
 	progress(0),
 	finished(false),
 	signalPrint(false),
+	signalReady(false),
+	waiting(false),
 	multiPageLoader(mpl),
 	webPage(*this),
 	lo(webPage),
@@ -177,27 +977,23 @@ ResourceObject::ResourceObject(MultiPageLoaderPrivate & mpl, const QUrl & u, con
 	connect(&networkAccessManager, SIGNAL(warning(const QString &)),
 			this, SLOT(warning(const QString &)));
 
-	networkAccessManager.setCookieJar(multiPageLoader.cookieJar);
+	connect(&networkAccessManager, SIGNAL(requestStarted()), this, SLOT(requestStarted()));
+	connect(&networkAccessManager, SIGNAL(idle()), this, SLOT(networkIdle()));
+	idleTimer.setSingleShot(true);
+	connect(&idleTimer, SIGNAL(timeout()), this, SLOT(idleTimeout()));
+	maxWaitTimer.setSingleShot(true);
+	connect(&maxWaitTimer, SIGNAL(timeout()), this, SLOT(maxWaitTimeout()));
 
-	//If we must use a proxy, create a host of objects
-	if (!settings.proxy.host.isEmpty()) {
-		QNetworkProxy proxy;
-		proxy.setHostName(settings.proxy.host);
-		proxy.setPort(settings.proxy.port);
-		proxy.setType(settings.proxy.type);
-		// to retrieve a web page, it's not needed to use a fully transparent
-		// http proxy. Moreover, the CONNECT() method is frequently disabled
-		// by proxies administrators.
-		if (settings.proxy.type == QNetworkProxy::HttpProxy)
-			proxy.setCapabilities(QNetworkProxy::CachingCapability |
-			                      QNetworkProxy::TunnelingCapability);
-		if (!settings.proxy.user.isEmpty())
-			proxy.setUser(settings.proxy.user);
-		if (!settings.proxy.password.isEmpty())
-			proxy.setPassword(settings.proxy.password);
-		networkAccessManager.setProxy(proxy);
+	if (settings.waitForReady) {
+		connect(webPage.mainFrame(), SIGNAL(javaScriptWindowObjectCleared()), this, SLOT(injectReadyCallback()));
+		connect(&readyCallback, SIGNAL(called()), this, SLOT(readyCalled()));
 	}
 
+	networkAccessManager.setShared(multiPageLoader.sharedNetworkAccessManager(settings));
+	//WebKit reads and writes document.cookie through the manager of the page
+	networkAccessManager.setCookieJar(multiPageLoader.cookieJar);
+	multiPageLoader.cookieJar->setParent(&multiPageLoader);
+
 	webPage.setNetworkAccessManager(&networkAccessManager);
 	webPage.mainFrame()->setZoomFactor(settings.zoomFactor);
 }
@@ -261,11 +1057,63 @@ void ResourceObject::loadFinished(bool ok) {
 
 	// XXX: If loading failed there's no need to wait
 	//      for javascript on this resource.
-	if (!ok || signalPrint || settings.jsdelay == 0) loadDone();
+	if (!ok || signalPrint) loadDone();
+	else if (settings.waitForReady || settings.networkIdle > 0) {
+		//Wait for the page to tell us it is ready, or for the network to become idle
+		if (settings.waitForReady && signalReady) loadDone();
+		else {
+			waiting = true;
+			if (settings.maxLoadWait > 0) maxWaitTimer.start(settings.maxLoadWait);
+			if (!settings.waitForReady && networkAccessManager.pendingReplies() == 0)
+				idleTimer.start(settings.networkIdle);
+		}
+	}
+	else if (settings.jsdelay == 0) loadDone();
 	else if (!settings.windowStatus.isEmpty()) waitWindowStatus();
 	else QTimer::singleShot(settings.jsdelay, this, SLOT(loadDone()));
 }
 
+/*!
+ * Expose window.wkhtmltopdfReady() to javascript, whenever the window object is reset
+ */
+void ResourceObject::injectReadyCallback() {
+	webPage.mainFrame()->addToJavaScriptWindowObject("__wkhtmltopdf", &readyCallback);
+	webPage.mainFrame()->evaluateJavaScript("window.wkhtmltopdfReady = function() {__wkhtmltopdf.ready();};");
+}
+
+/*!
+ * Called when javascript calls window.wkhtmltopdfReady(), possibly before the page has finished loading
+ */
+void ResourceObject::readyCalled() {
+	signalReady = true;
+	if (waiting) loadDone();
+}
+
+void ResourceObject::requestStarted() {
+	idleTimer.stop();
+}
+
+/*!
+ * Called when the last request in flight is done, the page is considered loaded
+ * if no new request is started within the network idle time
+ */
+void ResourceObject::networkIdle() {
+	if (waiting && !settings.waitForReady)
+		idleTimer.start(settings.networkIdle);
+}
+
+void ResourceObject::idleTimeout() {
+	if (networkAccessManager.pendingReplies() == 0) loadDone();
+}
+
+void ResourceObject::maxWaitTimeout() {
+	if (settings.waitForReady)
+		warning(QString("Page %1 did not call window.wkhtmltopdfReady() within %2 ms").arg(url.toString()).arg(settings.maxLoadWait));
+	else
+		warning(QString("The network did not become idle for page %1 within %2 ms").arg(url.toString()).arg(settings.maxLoadWait));
+	loadDone();
+}
+
 void ResourceObject::waitWindowStatus() {
 	QString windowStatus = webPage.mainFrame()->evaluateJavaScript("window.status").toString();
 	//warning(QString("window.status:" + windowStatus + " settings.windowStatus:" + settings.windowStatus));
@@ -281,9 +1129,32 @@ void ResourceObject::printRequested(QWebFrame *) {
 	loadDone();
 }
 
+/*!
+ * Stop loading at once, without reporting the page as loaded
+ */
+void ResourceObject::cancel() {
+	if (!finished) {
+		finished = true;
+		--multiPageLoader.loading;
+	}
+	waiting = false;
+	idleTimer.stop();
+	maxWaitTimer.stop();
+	//Aborting the page triggers signals we are no longer interested in
+	webPage.disconnect(this);
+	networkAccessManager.disconnect(this);
+	networkAccessManager.dispose();
+	webPage.triggerAction(QWebPage::Stop);
+	webPage.triggerAction(QWebPage::StopScheduledPageRefresh);
+	networkAccessManager.abortPending();
+}
+
 void ResourceObject::loadDone() {
 	if (finished) return;
 	finished=true;
+	waiting=false;
+	idleTimer.stop();
+	maxWaitTimer.stop();
 
 	// Ensure no more loading goes..
 	webPage.triggerAction(QWebPage::Stop);
@@ -378,43 +1249,41 @@ void ResourceObject::sslErrors(QNetworkReply *reply, const QList<QSslError> &) {
 
 void ResourceObject::load() {
 	finished=false;
+	signalReady=false;
 	++multiPageLoader.loading;
 
+	//In memory html is loaded as is, relative to the url of the resource
+	if (!content.isNull()) {
+		webPage.mainFrame()->setContent(content, "text/html", url);
+		return;
+	}
+
 	bool hasFiles=false;
 	foreach (const settings::PostItem & pi, settings.post) hasFiles |= pi.file;
 	QByteArray postData;
-	QString boundary;
 	if (hasFiles) {
-		boundary = QUuid::createUuid().toString().remove('-').remove('{').remove('}');
+		//Files are streamed from disk while the request is sent, rather than read into memory
+		QHttpMultiPart * body = new QHttpMultiPart(QHttpMultiPart::FormDataType);
 		foreach (const settings::PostItem & pi, settings.post) {
-			//TODO escape values here
-			postData.append("--");
-			postData.append(boundary);
-			postData.append("\ncontent-disposition: form-data; name=\"");
-			postData.append(pi.name);
-			postData.append('\"');
+			QHttpPart part;
+			QString disposition = QString("form-data; name=\"%1\"").arg(escapeQuotes(pi.name));
 			if (pi.file) {
-				QFile f(pi.value);
-				if (!f.open(QIODevice::ReadOnly) ) {
+				QFile * f = new QFile(pi.value, body);
+				if (!f->open(QIODevice::ReadOnly) ) {
+					delete body;
 					error(QString("Unable to open file ")+pi.value);
 					multiPageLoader.fail();
+					return;
 				}
-				postData.append("; filename=\"");
-				postData.append( QFileInfo(pi.value).fileName());
-				postData.append("\"\n\n");
-				postData.append( f.readAll() );
-				//TODO ADD MIME TYPE
-			} else {
-				postData.append("\n\n");
-				postData.append(pi.value);
-			}
-			postData.append('\n');
-		}
-		if (!postData.isEmpty()) {
-			postData.append("--");
-			postData.append(boundary);
-			postData.append("--\n");
+				disposition += QString("; filename=\"%1\"").arg(escapeQuotes(QFileInfo(pi.value).fileName()));
+				part.setHeader(QNetworkRequest::ContentTypeHeader, mimeTypeForFile(pi.value));
+				part.setBodyDevice(f);
+			} else
+				part.setBody(pi.value.toUtf8());
+			part.setHeader(QNetworkRequest::ContentDispositionHeader, disposition);
+			body->append(part);
 		}
+		networkAccessManager.setPostBody(body);
 	} else {
 #if QT_VERSION >= 0x050000
 		QUrlQuery q;
@@ -439,13 +1308,12 @@ void ResourceObject::load() {
 	foreach (const HT & j, settings.customHeaders)
 		r.setRawHeader(j.first.toLatin1(), j.second.toLatin1());
 
-	if (postData.isEmpty())
+	if (hasFiles)
+		webPage.mainFrame()->load(r, QNetworkAccessManager::PostOperation);
+	else if (postData.isEmpty())
 		webPage.mainFrame()->load(r);
-	else {
-		if (hasFiles)
-			r.setHeader(QNetworkRequest::ContentTypeHeader, QString("multipart/form-data, boundary=")+boundary);
+	else
 		webPage.mainFrame()->load(r, QNetworkAccessManager::PostOperation, postData);
-	}
 }
 
 void MyCookieJar::useCookie(const QUrl &, const QString & name, const QString & value) {
@@ -520,8 +1388,67 @@ MultiPageLoaderPrivate::~MultiPageLoaderPrivate() {
 	clearResources();
 }
 
-LoaderObject * MultiPageLoaderPrivate::addResource(const QUrl & url, const settings::LoadPage & page) {
+/*!
+  \brief Get the network stack used for resources with the given settings
+
+  All resources of the loader share a network stack, so connections are
+  kept alive and reused between them. Per resource policy is applied by
+  the MyNetworkAccessManager of each resource before forwarding requests.
+  A separate stack is only created if the cache directory, proxy or
+  connection limit differs.
+  \param page The settings of the resource
+*/
+SharedNetworkAccessManager * MultiPageLoaderPrivate::sharedNetworkAccessManager(const settings::LoadPage & page) {
+	QString key = QString("%1\n%2:%3:%4:%5:%6\n%7").arg(page.cacheDir, page.proxy.host)
+		.arg(page.proxy.port).arg(int(page.proxy.type)).arg(page.proxy.user, page.proxy.password)
+		.arg(page.hostConnections);
+	SharedNetworkAccessManager * nam = networkAccessManagers.value(key);
+	if (nam) return nam;
+
+	nam = new SharedNetworkAccessManager(this, page.hostConnections);
+	networkAccessManagers[key] = nam;
+
+	QNetworkDiskCache * diskCache = 0;
+	if (!page.cacheDir.isEmpty()) {
+		diskCache = new QNetworkDiskCache(nam);
+		diskCache->setCacheDirectory(page.cacheDir);
+	}
+	//The memory cache sits in front of the disk cache, and is shared with other loaders
+	if (settings.memoryCacheSize > 0) {
+		MemoryCache::setMaxSize(qint64(settings.memoryCacheSize) * 1024 * 1024);
+		nam->setCache(new MemoryNetworkCache(diskCache, nam));
+	} else if (diskCache)
+		nam->setCache(diskCache);
+
+	//The cookie jar is shared between the stacks, so keep it owned by the loader
+	nam->setCookieJar(cookieJar);
+	cookieJar->setParent(this);
+
+	//If we must use a proxy, create a host of objects
+	if (!page.proxy.host.isEmpty()) {
+		QNetworkProxy proxy;
+		proxy.setHostName(page.proxy.host);
+		proxy.setPort(page.proxy.port);
+		proxy.setType(page.proxy.type);
+		// to retrieve a web page, it's not needed to use a fully transparent
+		// http proxy. Moreover, the CONNECT() method is frequently disabled
+		// by proxies administrators.
+		if (page.proxy.type == QNetworkProxy::HttpProxy)
+			proxy.setCapabilities(QNetworkProxy::CachingCapability |
+			                      QNetworkProxy::TunnelingCapability);
+		if (!page.proxy.user.isEmpty())
+			proxy.setUser(page.proxy.user);
+		if (!page.proxy.password.isEmpty())
+			proxy.setPassword(page.proxy.password);
+		nam->setProxy(proxy);
+	}
+
+	return nam;
+}
+
+LoaderObject * MultiPageLoaderPrivate::addResource(const QUrl & url, const settings::LoadPage & page, const QByteArray * content) {
 	ResourceObject * ro = new ResourceObject(*this, url, page);
+	if (content) ro->content = *content;
 	resources.push_back(ro);
 
 	return &ro->lo;
@@ -550,14 +1477,17 @@ void MultiPageLoaderPrivate::clearResources() {
 		// on resources list, is it tries to delete
 		// each objet on removal.
 		ResourceObject *tmp = resources.takeFirst();
+		tmp->cancel();
 		tmp->deleteLater();
 	}
-	tempIn.remove();
 }
 
+/*!
+  \brief Stop loading all resources, aborting the requests in flight
+*/
 void MultiPageLoaderPrivate::cancel() {
-	//foreach (QWebPage * page, pages)
-	//	page->triggerAction(QWebPage::Stop);
+	foreach (ResourceObject * resource, resources)
+		resource->cancel();
 }
 
 void MultiPageLoaderPrivate::fail() {
@@ -582,28 +1512,27 @@ MultiPageLoader::~MultiPageLoader() {
 
 /*!
   \brief Add a resource, to be loaded described by a string
+
+  Html given as data, or read from stdin when the url is "-", is loaded
+  from memory relative to defaultBaseUrl().
   @param string Url describing the resource to load
+  @param data Html to load instead of the url, or NULL
 */
 LoaderObject * MultiPageLoader::addResource(const QString & string, const settings::LoadPage & s, const QString * data) {
-	QString url=string;
-	if (data && !data->isEmpty()) {
-		url = d->tempIn.create(".html");
-		QFile tmp(url);
-		if (!tmp.open(QIODevice::WriteOnly) || tmp.write(data->toUtf8())==0) {
-			emit error("Unable to create temporary file");
-			return NULL;
-		}
-	} else if (url == "-") {
+	if (data && !data->isEmpty())
+		return addResource(data->toUtf8(), defaultBaseUrl(), s);
+	if (string == "-") {
 		QFile in;
-		in.open(stdin,QIODevice::ReadOnly);
-		url = d->tempIn.create(".html");
-		QFile tmp(url);
-		if (!tmp.open(QIODevice::WriteOnly) || !copyFile(in, tmp)) {
-			emit error("Unable to create temporary file");
+		if (!in.open(stdin,QIODevice::ReadOnly)) {
+			emit error("Unable to read from stdin");
 			return NULL;
 		}
+		QByteArray html = in.readAll();
+		//Empty input is an empty page, not a request for the base url
+		if (html.isNull()) html = "";
+		return addResource(html, defaultBaseUrl(), s);
 	}
-	return addResource(guessUrlFromString(url), s);
+	return addResource(guessUrlFromString(string), s);
 }
 
 /*!
@@ -614,6 +1543,31 @@ LoaderObject * MultiPageLoader::addResource(const QUrl & url, const settings::Lo
 	return d->addResource(url, s);
 }
 
+/*!
+  \brief Add a page to be loaded from html kept in memory
+  @param html The utf-8 encoded html of the page
+  @param baseUrl Url relative references in the page are resolved against
+*/
+LoaderObject * MultiPageLoader::addResource(const QByteArray & html, const QUrl & baseUrl, const settings::LoadPage & s) {
+	return d->addResource(baseUrl, s, &html);
+}
+
+/*!
+  \brief Release a single loaded resource, deleting its page right away
+
+  This must not be called while handling a signal from the resource itself.
+  @param page The page of the resource to release
+  @return True if the page belonged to this loader
+*/
+bool MultiPageLoader::releaseResource(QWebPage * page) {
+	for (int i=0; i < d->resources.size(); ++i) {
+		if (&d->resources[i]->webPage != page) continue;
+		delete d->resources.takeAt(i);
+		return true;
+	}
+	return false;
+}
+
 /*!
   \brief Guess a url, by looking at a string
 
@@ -677,6 +1631,16 @@ QUrl MultiPageLoader::guessUrlFromString(const QString &string) {
 	return url;
 }
 
+/*!
+  \brief The url html given in memory is loaded relative to, when no other is given
+
+  Relative references resolve against the working directory, as they
+  would for a file there.
+*/
+QUrl MultiPageLoader::defaultBaseUrl() {
+	return QUrl::fromLocalFile(QDir::current().absoluteFilePath("wkhtmltopdf-input.html"));
+}
+
 /*!
   \brief Return the most severe http error code returned during loading
  */
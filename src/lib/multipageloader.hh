@@ -57,7 +57,10 @@ public:
 	~MultiPageLoader();
 	LoaderObject * addResource(const QString & url, const settings::LoadPage & settings, const QString * data=NULL);
 	LoaderObject * addResource(const QUrl & url, const settings::LoadPage & settings);
+	LoaderObject * addResource(const QByteArray & html, const QUrl & baseUrl, const settings::LoadPage & settings);
+	bool releaseResource(QWebPage * page);
 	static QUrl guessUrlFromString(const QString &string);
+	static QUrl defaultBaseUrl();
 	int httpErrorCode();
 	static bool copyFile(QFile & src, QFile & dst);
 public slots:
@@ -27,32 +27,181 @@
 #endif
 
 #include "multipageloader.hh"
-#include "tempfile.hh"
 #include <QAtomicInt>
 #include <QAuthenticator>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QHttpMultiPart>
+#include <QMutex>
 #include <QNetworkAccessManager>
 #include <QNetworkCookieJar>
 #include <QNetworkReply>
+#include <QPointer>
+#include <QTimer>
 #include <QWebFrame>
 
 #include "dllbegin.inc"
 namespace wkhtmltopdf {
 
+class DLL_LOCAL MyNetworkAccessManager;
+class DLL_LOCAL InFlightRequest;
+
+class DLL_LOCAL SharedNetworkAccessManager: public QNetworkAccessManager {
+	Q_OBJECT
+private:
+	//Maximal number of requests in flight per host, 0 for no limit
+	int hostConnections;
+	QHash<QString, int> active;
+	QList<InFlightRequest *> queue;
+	//Requests sent and not finished yet
+	QList<InFlightRequest *> sent;
+	static QMutex statisticsMutex;
+	static qint64 scheduledRequests;
+	static qint64 queuedTime;
+	static qint64 maxQueuedTime;
+	static qint64 downscaledImages;
+	static qint64 decodedBytesSaved;
+	void dispatch();
+public:
+	SharedNetworkAccessManager(QObject * parent, int hostConnections);
+	~SharedNetworkAccessManager();
+	QNetworkReply * forward(MyNetworkAccessManager * owner, Operation op, const QNetworkRequest & req, QIODevice * outgoingData);
+	QNetworkReply * forward(MyNetworkAccessManager * owner, const QNetworkRequest & req, QHttpMultiPart * body);
+	void schedule(InFlightRequest * request);
+	void unschedule(InFlightRequest * request);
+	void release(InFlightRequest * request);
+	static void statistics(qint64 & requests, qint64 & queued, qint64 & maxQueued);
+	static QByteArray downscaleImage(const QByteArray & data, int maxSize);
+	static void imageStatistics(qint64 & images, qint64 & saved);
+public slots:
+	void routeAuthenticationRequired(QNetworkReply * reply, QAuthenticator * authenticator);
+	void routeSslErrors(QNetworkReply * reply, const QList<QSslError> & errors);
+	void routeFinished(QNetworkReply * reply);
+};
+
+class DLL_LOCAL CoalescedReply: public QNetworkReply {
+	Q_OBJECT
+private:
+	InFlightRequest * source;
+	QByteArray buffer;
+	bool replayed;
+	void complete();
+	friend class InFlightRequest;
+public:
+	CoalescedReply(const QNetworkRequest & req, InFlightRequest * source, QObject * parent);
+	~CoalescedReply();
+	void abort();
+	qint64 bytesAvailable() const;
+	bool isSequential() const;
+protected:
+	qint64 readData(char * data, qint64 maxSize);
+public slots:
+	void replay();
+};
+
+class DLL_LOCAL InFlightRequest: public QObject {
+	Q_OBJECT
+private:
+	static QHash<QString, InFlightRequest *> inFlight;
+	QString key;
+	QPointer<SharedNetworkAccessManager> nam;
+	QNetworkRequest request;
+	QNetworkReply * reply;
+	QList<CoalescedReply *> followers;
+	QByteArray received;
+	bool metaDataReceived;
+	//Largest image size delivered, 0 to deliver images as downloaded
+	int maxImageSize;
+	//Is the response held back until it is complete, to be downscaled
+	bool holding;
+	InFlightRequest(const QString & key, SharedNetworkAccessManager * nam, const QNetworkRequest & req, int maxImageSize);
+	void copyMetaData(CoalescedReply * follower);
+	void unregister();
+public:
+	//The lower the value, the sooner the request is sent
+	int priority;
+	//Host and port the request counts against
+	QString host;
+	QElapsedTimer queued;
+	static QNetworkReply * get(SharedNetworkAccessManager * nam, MyNetworkAccessManager * owner, const QNetworkRequest & req, int maxImageSize);
+	MyNetworkAccessManager * owner() const;
+	void start();
+	void detach(CoalescedReply * follower);
+	void abandon();
+public slots:
+	void metaDataChanged();
+	void readyRead();
+	void finished();
+};
+
+class DLL_LOCAL StaticReply: public QNetworkReply {
+	Q_OBJECT
+private:
+	QByteArray content;
+public:
+	StaticReply(const QNetworkRequest & req, QNetworkAccessManager::Operation op, const QByteArray & data, const QString & mimeType, QObject * parent);
+	StaticReply(const QNetworkRequest & req, QNetworkAccessManager::Operation op, QObject * parent);
+	void abort();
+	qint64 bytesAvailable() const;
+	bool isSequential() const;
+protected:
+	qint64 readData(char * data, qint64 maxSize);
+public slots:
+	void deliver();
+};
+
+class DLL_LOCAL ResourceBlobs {
+private:
+	static QMutex mutex;
+	static QHash<QString, QPair<QByteArray, QString> > blobs;
+public:
+	static void add(const QUrl & url, const QByteArray & data, const QString & mimeType);
+	static void clear();
+	static bool lookup(const QUrl & url, QByteArray & data, QString & mimeType);
+};
+
 class DLL_LOCAL MyNetworkAccessManager: public QNetworkAccessManager {
 	Q_OBJECT
 private:
 	bool disposed;
 	QSet<QString> allowed;
 	const settings::LoadPage & settings;
+	QPointer<SharedNetworkAccessManager> shared;
+	QSet<QObject *> pending;
+	QPointer<QHttpMultiPart> postBody;
+	bool carriesCredentials(const QNetworkRequest & req) const;
+	QNetworkReply * mappedReply(Operation op, const QNetworkRequest & req);
+	QNetworkReply * route(Operation op, const QNetworkRequest & req, QIODevice * outgoingData);
 public:
 	void dispose();
 	void allow(QString path);
 	MyNetworkAccessManager(const settings::LoadPage & s);
+	void setShared(SharedNetworkAccessManager * s);
+	void setPostBody(QHttpMultiPart * body);
+	void replyAuthenticationRequired(QNetworkReply * reply, QAuthenticator * authenticator);
+	void replySslErrors(QNetworkReply * reply, const QList<QSslError> & errors);
+	void replyFinished(QNetworkReply * reply);
+	int pendingReplies() const;
+	void abortPending();
 	QNetworkReply * createRequest(Operation op, const QNetworkRequest & req, QIODevice * outgoingData = 0);
+public slots:
+	void replyDone();
+	void replyDestroyed(QObject * reply);
+	void replyTimedOut();
 signals:
 	void warning(const QString & text);
+	void requestStarted();
+	void idle();
+};
+
+class DLL_LOCAL ReadyCallback: public QObject {
+	Q_OBJECT
+public slots:
+	void ready();
+signals:
+	void called();
 };
 
 class DLL_LOCAL MultiPageLoaderPrivate;
@@ -81,11 +230,17 @@ private:
 	int progress;
 	bool finished;
 	bool signalPrint;
+	bool signalReady;
+	bool waiting;
+	QTimer idleTimer;
+	QTimer maxWaitTimer;
+	ReadyCallback readyCallback;
 	MultiPageLoaderPrivate & multiPageLoader;
 public:
 	ResourceObject(MultiPageLoaderPrivate & mpl, const QUrl & u, const settings::LoadPage & s);
 	MyQWebPage webPage;
 	LoaderObject lo;
+	QByteArray content;
 	int httpErrorCode;
 	const settings::LoadPage settings;
 public slots:
@@ -95,7 +250,14 @@ public slots:
 	void loadFinished(bool ok);
 	void waitWindowStatus();
 	void printRequested(QWebFrame * frame);
+	void injectReadyCallback();
+	void readyCalled();
+	void requestStarted();
+	void networkIdle();
+	void idleTimeout();
+	void maxWaitTimeout();
 	void loadDone();
+	void cancel();
 	void handleAuthenticationRequired(QNetworkReply *reply, QAuthenticator *authenticator);
 	void warning(const QString & str);
 	void error(const QString & str);
@@ -117,6 +279,8 @@ class DLL_LOCAL MultiPageLoaderPrivate: public QObject {
 	Q_OBJECT
 public:
 	MyCookieJar * cookieJar;
+	//Network stacks shared by all resources, keyed by cache and proxy settings
+	QHash<QString, SharedNetworkAccessManager *> networkAccessManagers;
 
 	MultiPageLoader & outer;
 	const settings::LoadGlobal settings;
@@ -128,14 +292,14 @@ public:
 	bool loadStartedEmitted;
 	bool hasError;
 	bool finishedEmitted;
-	TempFile tempIn;
 
 	MultiPageLoaderPrivate(const settings::LoadGlobal & settings, MultiPageLoader & o);
 	~MultiPageLoaderPrivate();
-	LoaderObject * addResource(const QUrl & url, const settings::LoadPage & settings);
+	LoaderObject * addResource(const QUrl & url, const settings::LoadPage & settings, const QByteArray * content=NULL);
 	void load();
 	void clearResources();
 	void cancel();
+	SharedNetworkAccessManager * sharedNetworkAccessManager(const settings::LoadPage & page);
 public slots:
 	void fail();
 	void loadDone();
@@ -64,7 +64,7 @@ void OutlineItem::fillAnchors(const OutlineItem * other,
 
 	if (other) {
 		anchor = other->anchor;
-		tocAnchor = other->anchor;
+		tocAnchor = other->tocAnchor;
 	} else {
 		anchor = QString("__WKANCHOR_")+QString::number(anchorCounter++,36);
 		tocAnchor = QString("__WKANCHOR_")+QString::number(anchorCounter++,36);
@@ -147,6 +147,13 @@ void OutlinePrivate::dumpChildren(QTextStream & stream, const QList<OutlineItem
 	}
 }
 
+void OutlinePrivate::listPageNumbers(QList<QPair<QString, QString> > & pages, const QList<OutlineItem *> & items) const {
+	foreach (OutlineItem * item, items) {
+		pages.push_back(qMakePair(item->tocAnchor, QString::number(item->page + prefixSum[item->document] + settings.pageOffset)));
+		listPageNumbers(pages, item->children);
+	}
+}
+
 void OutlinePrivate::buildPrefixSum() {
 	prefixSum.clear();
 	prefixSum.push_back(0);
@@ -162,6 +169,19 @@ void Outline::dump(QTextStream & stream) const {
 	stream << "</outline>" << endl;
 }
 
+/*!
+  \brief List the toc anchor and page number of every item, in the order they are dumped
+
+  As long as the outline keeps its structure the anchors stay the same, so this can be
+  used to find the page numbers that changed in a table of content.
+  \param pages The list to fill
+*/
+void Outline::tocPageNumbers(QList<QPair<QString, QString> > & pages) const {
+	d->buildPrefixSum();
+	pages.clear();
+	d->listPageNumbers(pages, d->documentOutlines);
+}
+
 /*!
   \file outline.hh
   \brief Defines the Outline class
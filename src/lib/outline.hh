@@ -50,12 +50,17 @@ public:
 	void printOutline(QPrinter * printer);
 
 	void dump(QTextStream & stream) const;
+	void tocPageNumbers(QList<QPair<QString, QString> > & pages) const;
+	void dumpDefaultTOC(QTextStream & stream, const settings::TableOfContent & s) const;
 private:
 	OutlinePrivate * d;
 	friend class TocPrinter;
 	friend class TocPrinterPrivate;
 };
 
+//! Escape a string for use in html or xml markup
+QString escape(QString str);
+
 #include "dllend.inc"
 }
 #endif //__EXTENSIVE_WKHTMLTOPDF_QT_HACK__
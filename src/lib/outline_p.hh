@@ -71,6 +71,8 @@ public:
 	void outlineChildren(OutlineItem * item, QPrinter * printer, int level);
 	void buildHFCache(OutlineItem * i, int level);
 	void dumpChildren(QTextStream & stream, const QList<OutlineItem *> & items, int level) const;
+	void listPageNumbers(QList<QPair<QString, QString> > & pages, const QList<OutlineItem *> & items) const;
+	void dumpDefaultTOCChildren(QTextStream & stream, const QList<OutlineItem *> & items, const settings::TableOfContent & s, int level) const;
 };
 
 #include "dllend.inc"
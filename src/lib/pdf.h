@@ -35,8 +35,10 @@ typedef struct wkhtmltopdf_converter wkhtmltopdf_converter;
 typedef void (*wkhtmltopdf_str_callback)(wkhtmltopdf_converter * converter, const char * str);
 typedef void (*wkhtmltopdf_int_callback)(wkhtmltopdf_converter * converter, const int val);
 typedef void (*wkhtmltopdf_void_callback)(wkhtmltopdf_converter * converter);
+typedef void (*wkhtmltopdf_output_callback)(wkhtmltopdf_converter * converter, const unsigned char * data, long size, void * userdata);
 
 CAPI(int) wkhtmltopdf_init(int use_graphics);
+CAPI(int) wkhtmltopdf_init_threaded(int use_graphics);
 CAPI(int) wkhtmltopdf_deinit();
 CAPI(int) wkhtmltopdf_extended_qt();
 CAPI(const char *) wkhtmltopdf_version();
@@ -61,11 +63,20 @@ CAPI(void) wkhtmltopdf_set_error_callback(wkhtmltopdf_converter * converter, wkh
 CAPI(void) wkhtmltopdf_set_phase_changed_callback(wkhtmltopdf_converter * converter, wkhtmltopdf_void_callback cb);
 CAPI(void) wkhtmltopdf_set_progress_changed_callback(wkhtmltopdf_converter * converter, wkhtmltopdf_int_callback cb);
 CAPI(void) wkhtmltopdf_set_finished_callback(wkhtmltopdf_converter * converter, wkhtmltopdf_int_callback cb);
-/* CAPI(void) wkhtmltopdf_begin_conversion(wkhtmltopdf_converter * converter); */
-/* CAPI(void) wkhtmltopdf_cancel(wkhtmltopdf_converter * converter); */
+CAPI(void) wkhtmltopdf_set_output_callback(wkhtmltopdf_converter * converter, wkhtmltopdf_output_callback cb, void * userdata);
+CAPI(void) wkhtmltopdf_begin_conversion(wkhtmltopdf_converter * converter);
+CAPI(void) wkhtmltopdf_cancel(wkhtmltopdf_converter * converter);
+CAPI(void) wkhtmltopdf_process_events(int timeout);
+CAPI(void) wkhtmltopdf_memory_cache_statistics(long long * hits, long long * misses, long long * bytes);
+CAPI(void) wkhtmltopdf_request_statistics(long long * requests, long long * queued_ms, long long * max_queued_ms);
+CAPI(void) wkhtmltopdf_image_statistics(long long * images, long long * decoded_bytes_saved);
+CAPI(void) wkhtmltopdf_register_blob(const char * url, const unsigned char * data, long length, const char * mime_type);
+CAPI(void) wkhtmltopdf_clear_blobs();
 CAPI(int) wkhtmltopdf_convert(wkhtmltopdf_converter * converter);
 CAPI(void) wkhtmltopdf_add_object(
 	wkhtmltopdf_converter * converter, wkhtmltopdf_object_settings * setting, const char * data);
+CAPI(void) wkhtmltopdf_add_object_data(
+	wkhtmltopdf_converter * converter, wkhtmltopdf_object_settings * setting, const char * data, long length, const char * base_url);
 
 CAPI(int) wkhtmltopdf_current_phase(wkhtmltopdf_converter * converter);
 CAPI(int) wkhtmltopdf_phase_count(wkhtmltopdf_converter * converter);
@@ -29,11 +29,14 @@
  * \brief Provides C bindings for pdf conversion
  */
 #include "pdf_c_bindings_p.hh"
+#include "memorycache.hh"
+#include "multipageloader_p.hh"
 #include "utilities.hh"
 #include <QApplication>
 #include <QWebFrame>
 
 #include <QHash>
+#include <QTimer>
 
 #include "dllbegin.inc"
 /**
@@ -69,6 +72,20 @@
  * - \b load.jsdelay The mount of time in milliseconds to wait after a page has done loading until
  *      it is actually printed. E.g. "1200". We will wait this amount of time or until, javascript
  *      calls window.print().
+ * - \b load.networkIdle Consider the page loaded once no requests have been in flight for this many
+ *      milliseconds, instead of waiting for load.jsdelay, e.g. "500". "0" disables it.
+ * - \b load.waitForReady Consider the page loaded once javascript calls window.wkhtmltopdfReady(),
+ *      instead of waiting for load.jsdelay. Must be either "true" or "false".
+ * - \b load.maxLoadWait The longest time in milliseconds to wait for load.networkIdle or
+ *      load.waitForReady, e.g. "30000".
+ * - \b load.resourceTimeout Abort requests for resources taking longer than this many milliseconds.
+ *      "0" disables the timeout.
+ * - \b load.hostConnections The maximal number of requests in flight per host, e.g. "6". Queued
+ *      requests are sent by priority, stylesheets and fonts before images. "0" disables the limit.
+ * - \b load.httpPipelining Allow http pipelining of requests. Must be either "true" or "false".
+ * - \b load.maxImageSize Scale downloaded jpeg and png images down to at most this many pixels wide
+ *      and high, e.g. "2000". "0" disables it. This changes the intrinsic size of the images, so
+ *      images without a width and height given by the document are laid out smaller.
  * - \b load.zoomFactor How much should we zoom in on the content? E.g. "2.2".
  * - \b load.customHeaders TODO
  * - \b load.repertCustomHeaders Should the custom headers be sent all elements loaded instead of
@@ -86,6 +103,10 @@
  *      - "ignore" Try to add the object to the final output.
  * - \b load.proxy String describing what proxy to use when loading the object.
  * - \b load.runScript TODO
+ * - \b load.cacheDir Directory used to cache downloaded resources on disk.
+ * - \b load.immutableHosts List of hosts whose cached resources are used without revalidation.
+ * - \b load.urlMappings List of url prefixes served from local directories, without using the
+ *      network, e.g. "https://assets.example/,/srv/assets/". See also \ref wkhtmltopdf_register_blob.
  *
  * \section pageHeaderFooter Header and footer settings
  * The same settings can be applied for headers and footers, here there are explained in
@@ -127,7 +148,22 @@
  * - \b imageDPI The maximal DPI to use for images in the pdf document.
  * - \b imageQuality The jpeg compression factor to use when producing the pdf document, e.g. "92".
  * - \b useNativeFormatPrinter Should we use QPrinter::NativeFormat when creating the pdf file? Must be either "true" or "false". (Mac OS X only).
+ * - \b releaseSpooledPages Should pages, headers and footers be freed as soon as they have been printed?
+ *      This bounds the memory used by documents made of many objects. Has no effect when printing
+ *      collated copies. Links from headers and footers to pages that were already freed are
+ *      dropped with a warning. Must be either "true" or "false".
+ * - \b downscaleImages Should jpeg and png images be scaled down when they are downloaded, so they
+ *      are no larger than imageDPI allows on the paper size? The limit never goes below the css
+ *      pixels the page is laid out on, so only images wider than the page change size in the
+ *      layout. Must be either "true" or "false".
  * - \b load.cookieJar Path of file used to load and store cookies.
+ * - \b load.memoryCacheSize Megabytes of downloaded resources to keep in memory, shared
+ *      by all conversions of the process, e.g. "64". The default "0" disables the cache.
+ *      Responses to requests carrying credentials are never cached.
+ * - \b load.jobTimeout Fail the conversion if it takes longer than this many milliseconds, e.g. "60000".
+ *      "0" disables the deadline.
+ * - \b load.phaseTimeout Fail the conversion if a single phase takes longer than this many
+ *      milliseconds. "0" disables the deadline.
  *
  * \section pagePdfObject Pdf object settings
  * The \ref wkhtmltopdf_object_settings structure contains the following settings:
@@ -142,6 +178,8 @@
  * - \b page The URL or path of the web page to convert, if "-" input is read from stdin.
  * - \b header.* Header specific settings see \ref pageHeaderFooter.
  * - \b footer.* Footer specific settings see \ref pageHeaderFooter.
+ * - \b templateHeaderFooter Should the html header and footer be loaded only once and have
+ *      the variables substituted for every page? Must be either "true" or "false".
  * - \b useExternalLinks Should external links in the HTML document be converted into
  *      external pdf links? Must be either "true" or "false.
  * - \b useLocalLinks Should internal links in the HTML document be converted into pdf
@@ -212,6 +250,79 @@
 using namespace wkhtmltopdf;
 QApplication * a = 0;
 int usage = 0;
+RuntimeThread * runtime = 0;
+
+/*
+ * Create the application and style used by all conversions
+ */
+static void createApplication(bool use_graphics) {
+	//QApplication keeps references to the arguments
+	static char x[] = "wkhtmltox";
+	static char * arg[] = {x, 0};
+	static int aa = 1;
+
+	bool ug = true;
+#if defined(Q_WS_X11) || defined(Q_WS_MACX)
+#ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+	ug = use_graphics;
+	if (!ug) QApplication::setGraphicsSystem("raster");
+#endif
+#endif
+	a = new QApplication(aa, arg, ug);
+	MyLooksStyle * style = new MyLooksStyle();
+	a->setStyle(style);
+}
+
+void RuntimeDispatcher::run(void * task) {
+	reinterpret_cast<RuntimeTask *>(task)->run();
+}
+
+RuntimeThread::RuntimeThread(bool ug): useGraphics(ug), dispatcher(0) {}
+
+void RuntimeThread::run() {
+	createApplication(useGraphics);
+	RuntimeDispatcher d;
+	mutex.lock();
+	dispatcher = &d;
+	started.wakeAll();
+	mutex.unlock();
+
+	a->exec();
+
+	dispatcher = 0;
+	delete a;
+	a = 0;
+}
+
+/*
+ * Run a task on the thread running Qt, and wait for it to be done
+ */
+void runInRuntime(RuntimeTask & task) {
+	if (runtime == 0 || QThread::currentThread() == runtime) {
+		task.run();
+		return;
+	}
+	QMetaObject::invokeMethod(runtime->dispatcher, "run", Qt::BlockingQueuedConnection, Q_ARG(void *, &task));
+}
+
+/*
+ * Run a conversion on the thread owning the converter, waiting for it to finish
+ */
+int convertInRuntime(QObject * owner, wkhtmltopdf::Converter & converter, QSemaphore * & waiter, const bool & succeeded) {
+	if (owner->thread() == QThread::currentThread()) return converter.convert();
+	QSemaphore done;
+	waiter = &done;
+	QMetaObject::invokeMethod(&converter, "beginConvertion", Qt::QueuedConnection);
+	done.acquire();
+	waiter = 0;
+	return succeeded;
+}
+
+struct DLL_LOCAL CreatePdfConverter: public RuntimeTask {
+	settings::PdfGlobal * settings;
+	MyPdfConverter * converter;
+	void run() {converter = new MyPdfConverter(settings);}
+};
 
 void MyPdfConverter::warning(const QString & message) {
 	if (warning_cb) (warning_cb)(reinterpret_cast<wkhtmltopdf_converter*>(this), message.toUtf8().constData());
@@ -231,17 +342,24 @@ void MyPdfConverter::progressChanged(int progress) {
 
 void MyPdfConverter::finished(bool ok) {
 	if (finished_cb) (finished_cb)(reinterpret_cast<wkhtmltopdf_converter*>(this), ok);
+	succeeded = ok;
+	if (waiter) waiter->release();
+}
+
+void MyPdfConverter::outputChunk(const QByteArray & data) {
+	if (output_cb) (output_cb)(reinterpret_cast<wkhtmltopdf_converter*>(this), (const unsigned char*)data.constData(), data.size(), output_userdata);
 }
 
 MyPdfConverter::MyPdfConverter(settings::PdfGlobal * gs):
 	warning_cb(0), error_cb(0), phase_changed(0), progress_changed(0), finished_cb(0),
-	converter(*gs), globalSettings(gs) {
+	output_cb(0), output_userdata(0), waiter(0), succeeded(false), converter(*gs), globalSettings(gs) {
 
     connect(&converter, SIGNAL(warning(const QString &)), this, SLOT(warning(const QString &)));
 	connect(&converter, SIGNAL(error(const QString &)), this, SLOT(error(const QString &)));
 	connect(&converter, SIGNAL(phaseChanged()), this, SLOT(phaseChanged()));
 	connect(&converter, SIGNAL(progressChanged(int)), this, SLOT(progressChanged(int)));
 	connect(&converter, SIGNAL(finished(bool)), this, SLOT(finished(bool)));
+	connect(&converter, SIGNAL(outputChunk(const QByteArray &)), this, SLOT(outputChunk(const QByteArray &)));
 }
 
 MyPdfConverter::~MyPdfConverter() {
@@ -291,23 +409,40 @@ CAPI(const char *) wkhtmltopdf_version() {
 CAPI(int) wkhtmltopdf_init(int use_graphics) {
 	++usage;
 
-	if (qApp == 0) {
-		char x[256];
-		strcpy(x, "wkhtmltox");
-		char * arg[] = {x, 0};
-		int aa = 1;
+	if (qApp == 0) createApplication(use_graphics);
+	return 1;
+}
 
-		bool ug = true;
-#if defined(Q_WS_X11) || defined(Q_WS_MACX)
-#ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
-		ug = use_graphics;
-		if (!ug) QApplication::setGraphicsSystem("raster");
-#endif
-#endif
-		a = new QApplication(aa, arg, ug);
-		MyLooksStyle * style = new MyLooksStyle();
-		a->setStyle(style);
-	}
+/**
+ * \brief Setup wkhtmltopdf to be used from any thread
+ *
+ * Like \ref wkhtmltopdf_init, but Qt is run on a thread owned by wkhtmltopdf. Converters can
+ * then be created and run from any thread, and several threads can be converting at the same
+ * time. Settings objects are plain data, and can be created on one thread and handed to another.
+ *
+ * The callbacks of a converter are called on the wkhtmltopdf thread. \ref wkhtmltopdf_convert
+ * blocks the calling thread until the conversion is done, while \ref wkhtmltopdf_begin_conversion
+ * returns at once and reports through the finished callback. There is no need to call
+ * \ref wkhtmltopdf_process_events. A converter should only be used by one thread at a time.
+ *
+ * As Qt is not run on the main thread of the application, use_graphics should be 0.
+ *
+ * \param use_graphics Should we use a graphics system
+ * \returns 1 on success and 0 otherwise
+ *
+ * \sa wkhtmltopdf_init, wkhtmltopdf_deinit
+ */
+CAPI(int) wkhtmltopdf_init_threaded(int use_graphics) {
+	++usage;
+
+	//If the application already runs Qt, it has to be used from its thread
+	if (qApp != 0) return 1;
+	runtime = new RuntimeThread(use_graphics);
+	runtime->mutex.lock();
+	runtime->start();
+	while (runtime->dispatcher == 0)
+		runtime->started.wait(&runtime->mutex);
+	runtime->mutex.unlock();
 	return 1;
 }
 
@@ -324,6 +459,13 @@ CAPI(int) wkhtmltopdf_init(int use_graphics) {
 CAPI(int) wkhtmltopdf_deinit() {
 	--usage;
 	if (usage != 0) return 1;
+	if (runtime != 0) {
+		QMetaObject::invokeMethod(a, "quit", Qt::QueuedConnection);
+		runtime->wait();
+		delete runtime;
+		runtime = 0;
+		return 1;
+	}
 	if (a != 0) delete a;
 	return 1;
 }
@@ -451,9 +593,11 @@ CAPI(int) wkhtmltopdf_get_object_setting(wkhtmltopdf_object_settings * settings,
  * \returns A wkhtmltopdf converter object
  */
 CAPI(wkhtmltopdf_converter *) wkhtmltopdf_create_converter(wkhtmltopdf_global_settings * settings) {
-
-	return reinterpret_cast<wkhtmltopdf_converter *>(
-		new MyPdfConverter(reinterpret_cast<settings::PdfGlobal *>(settings)));
+	//The converter has to live on the thread running Qt
+	CreatePdfConverter task;
+	task.settings = reinterpret_cast<settings::PdfGlobal *>(settings);
+	runInRuntime(task);
+	return reinterpret_cast<wkhtmltopdf_converter *>(task.converter);
 }
 
 /**
@@ -530,9 +674,143 @@ CAPI(void) wkhtmltopdf_set_finished_callback(wkhtmltopdf_converter * converter,
 	reinterpret_cast<MyPdfConverter *>(converter)->finished_cb = cb;
 }
 
-//CAPI(void) wkhtmltopdf_begin_conversion(wkhtmltopdf_converter * converter) {
-//	reinterpret_cast<MyPdfConverter *>(converter)->converter.beginConvertion();
-//}
+/**
+ * \brief Set the function that should receive the output document while it is produced.
+ *
+ * If no "out" location is specified in the global settings, the output pdf document is handed
+ * to the callback in chunks as pages are printed, instead of being stored in a buffer. The chunks
+ * must be consumed (copied) before the callback returns, and \ref wkhtmltopdf_get_output will return
+ * no data. Passing a NULL callback restores the buffering.
+ *
+ * \param converter The converter which output to stream
+ * \param cb The function to call with every chunk of output
+ * \param userdata Pointer passed on to the callback unchanged
+ *
+ * \sa wkhtmltopdf_get_output
+ */
+CAPI(void) wkhtmltopdf_set_output_callback(wkhtmltopdf_converter * converter, wkhtmltopdf_output_callback cb, void * userdata) {
+	MyPdfConverter * conv = reinterpret_cast<MyPdfConverter *>(converter);
+	conv->output_cb = cb;
+	conv->output_userdata = userdata;
+	conv->converter.setStreamOutput(cb != 0);
+}
+
+/**
+ * \brief Start converting the input objects into a pdf document, without waiting for it
+ *
+ * The conversion progresses while events are processed, by \ref wkhtmltopdf_process_events or
+ * by a Qt event loop run by the application, and reports progress through the callbacks just
+ * like \ref wkhtmltopdf_convert. Once the finished callback has been called the output can be
+ * retrieved as usual. Any number of converters can be converting at the same time.
+ *
+ * \param converter The converter to start
+ *
+ * \sa wkhtmltopdf_convert, wkhtmltopdf_set_finished_callback, wkhtmltopdf_process_events
+ */
+CAPI(void) wkhtmltopdf_begin_conversion(wkhtmltopdf_converter * converter) {
+	//Queued when called from another thread than the one running Qt
+	QMetaObject::invokeMethod(&reinterpret_cast<MyPdfConverter *>(converter)->converter, "beginConvertion");
+}
+
+/**
+ * \brief Process the events of the running conversions
+ *
+ * Waits until there are events to process, or \a timeout milliseconds have passed, and
+ * processes them. Applications that do not run a Qt event loop should call this repeatedly
+ * while conversions started by \ref wkhtmltopdf_begin_conversion are running.
+ *
+ * \param timeout The longest time to wait for events in milliseconds, 0 to only process pending events
+ *
+ * \sa wkhtmltopdf_begin_conversion
+ */
+CAPI(void) wkhtmltopdf_process_events(int timeout) {
+	if (timeout <= 0) {
+		qApp->processEvents(QEventLoop::AllEvents);
+		return;
+	}
+	//The timer wakes us up if nothing else happens
+	QTimer timer;
+	timer.setSingleShot(true);
+	timer.start(timeout);
+	qApp->processEvents(QEventLoop::AllEvents | QEventLoop::WaitForMoreEvents);
+}
+
+/**
+ * \brief Read the counters of the in memory resource cache
+ *
+ * The cache is enabled by the load.memoryCacheSize global setting, and is shared by all
+ * converters of the process. The counters can be used to choose a size for it.
+ *
+ * \param hits Set to the number of requests served from memory
+ * \param misses Set to the number of requests not found in memory
+ * \param bytes Set to the number of bytes currently held in memory
+ */
+CAPI(void) wkhtmltopdf_memory_cache_statistics(long long * hits, long long * misses, long long * bytes) {
+	qint64 h, m, b;
+	MemoryCache::statistics(h, m, b);
+	*hits = h;
+	*misses = m;
+	*bytes = b;
+}
+
+/**
+ * \brief Read how long requests waited to be sent
+ *
+ * Requests to a host are queued by priority once load.hostConnections requests to it are in
+ * flight. The counters cover all converters of the process.
+ *
+ * \param requests Set to the number of requests sent through the queue
+ * \param queued_ms Set to the total time in milliseconds requests waited in the queue
+ * \param max_queued_ms Set to the longest time in milliseconds a request waited in the queue
+ */
+CAPI(void) wkhtmltopdf_request_statistics(long long * requests, long long * queued_ms, long long * max_queued_ms) {
+	qint64 r, q, m;
+	SharedNetworkAccessManager::statistics(r, q, m);
+	*requests = r;
+	*queued_ms = q;
+	*max_queued_ms = m;
+}
+
+/**
+ * \brief Read how many images were scaled down while loading
+ *
+ * Images larger than load.maxImageSize are scaled down as soon as they are downloaded, so
+ * the page never decodes them at full size. The counters cover all converters of the process.
+ *
+ * \param images Set to the number of images scaled down
+ * \param decoded_bytes_saved Set to the number of bytes the decoded images no longer take up
+ */
+CAPI(void) wkhtmltopdf_image_statistics(long long * images, long long * decoded_bytes_saved) {
+	qint64 i, s;
+	SharedNetworkAccessManager::imageStatistics(i, s);
+	*images = i;
+	*decoded_bytes_saved = s;
+}
+
+/**
+ * \brief Serve a url from memory instead of fetching it
+ *
+ * Whenever an object, or a resource referenced by it, is loaded from \a url, the given data
+ * is used without touching the network. Blobs are shared by all converters of the process,
+ * and can be registered from any thread, also while conversions are running.
+ *
+ * \param url The url to serve, e.g. "https://assets.example/logo.png"
+ * \param data The content to serve, which is copied
+ * \param length The length of the content in bytes
+ * \param mime_type The mime type of the content, e.g. "image/png"
+ *
+ * \sa wkhtmltopdf_clear_blobs
+ */
+CAPI(void) wkhtmltopdf_register_blob(const char * url, const unsigned char * data, long length, const char * mime_type) {
+	ResourceBlobs::add(QUrl(QString::fromUtf8(url)), QByteArray(reinterpret_cast<const char *>(data), length), QString::fromUtf8(mime_type));
+}
+
+/**
+ * \brief Forget all blobs registered with \ref wkhtmltopdf_register_blob
+ */
+CAPI(void) wkhtmltopdf_clear_blobs() {
+	ResourceBlobs::clear();
+}
 
 /**
  * \brief Convert the input objects into a pdf document
@@ -549,12 +827,25 @@ CAPI(void) wkhtmltopdf_set_finished_callback(wkhtmltopdf_converter * converter,
  * \returns 1 on success and 0 otherwise
  */
 CAPI(int) wkhtmltopdf_convert(wkhtmltopdf_converter * converter) {
-	return reinterpret_cast<MyPdfConverter *>(converter)->converter.convert();
+	MyPdfConverter * c = reinterpret_cast<MyPdfConverter *>(converter);
+	return convertInRuntime(c, c->converter, c->waiter, c->succeeded);
 }
 
-//CAPI(void) wkhtmltopdf_cancel(wkhtmltopdf_converter * converter) {
-//	reinterpret_cast<MyPdfConverter *>(converter)->converter.cancel();
-//}
+/**
+ * \brief Cancel a running conversion
+ *
+ * Loading is stopped, requests in flight are aborted, and the conversion fails promptly.
+ * \ref wkhtmltopdf_http_error_code then returns 2000, while a conversion failed by the
+ * load.jobTimeout or load.phaseTimeout deadlines returns 2001. This may be called from the
+ * callbacks of the converter, or from any thread when using \ref wkhtmltopdf_init_threaded.
+ * The conversion is stopped once the callback has returned, or at the next page when the
+ * document is being printed, and nothing is freed before that.
+ *
+ * \param converter The converter to cancel
+ */
+CAPI(void) wkhtmltopdf_cancel(wkhtmltopdf_converter * converter) {
+	reinterpret_cast<MyPdfConverter *>(converter)->converter.cancel();
+}
 
 /**
  * \brief add an object (web page to convert)
@@ -570,9 +861,30 @@ CAPI(int) wkhtmltopdf_convert(wkhtmltopdf_converter * converter) {
  * \param data HTML content of the object to convert or NULL
  */
 CAPI(void) wkhtmltopdf_add_object(wkhtmltopdf_converter * converter, wkhtmltopdf_object_settings * settings, const char * data) {
-	QString str= QString::fromUtf8(data);
 	reinterpret_cast<MyPdfConverter *>(converter)->converter.addResource(
-		*reinterpret_cast<settings::PdfObject *>(settings), &str);
+		*reinterpret_cast<settings::PdfObject *>(settings), QByteArray(data), QUrl());
+	reinterpret_cast<MyPdfConverter *>(converter)->objectSettings.push_back(reinterpret_cast<settings::PdfObject *>(settings));
+}
+
+/**
+ * \brief add an object given as html in memory
+ *
+ * Like \ref wkhtmltopdf_add_object, but the html does not need to be zero terminated, and is
+ * handed to the renderer without being written to a temporary file. The data is copied, so it
+ * may be freed as soon as this function returns.
+ *
+ * \param converter The converter to add the object to
+ * \param settings The setting describing the object to add
+ * \param data The utf8 encoded HTML content of the object
+ * \param length The length of data in bytes
+ * \param base_url Url or path relative references in the html resolve against, if NULL
+ *        they resolve against the working directory
+ */
+CAPI(void) wkhtmltopdf_add_object_data(wkhtmltopdf_converter * converter, wkhtmltopdf_object_settings * settings, const char * data, long length, const char * base_url) {
+	QUrl base;
+	if (base_url) base = MultiPageLoader::guessUrlFromString(QString::fromUtf8(base_url));
+	reinterpret_cast<MyPdfConverter *>(converter)->converter.addResource(
+		*reinterpret_cast<settings::PdfObject *>(settings), QByteArray(data, length), base);
 	reinterpret_cast<MyPdfConverter *>(converter)->objectSettings.push_back(reinterpret_cast<settings::PdfObject *>(settings));
 }
 
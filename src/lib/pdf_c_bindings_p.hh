@@ -30,10 +30,44 @@
 #include "pdfconverter.hh"
 #include <QObject>
 #include <QHash>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThread>
+#include <QWaitCondition>
 #include <vector>
 
 #include "dllbegin.inc"
 
+/* Work to be done on the thread running Qt, see runInRuntime */
+class DLL_LOCAL RuntimeTask {
+public:
+	virtual ~RuntimeTask() {}
+	virtual void run() = 0;
+};
+
+class DLL_LOCAL RuntimeDispatcher: public QObject {
+	Q_OBJECT
+public slots:
+	void run(void * task);
+};
+
+/* Thread owning the QApplication, when started by wkhtmltopdf_init_threaded */
+class DLL_LOCAL RuntimeThread: public QThread {
+	Q_OBJECT
+public:
+	bool useGraphics;
+	QMutex mutex;
+	QWaitCondition started;
+	RuntimeDispatcher * dispatcher;
+
+	RuntimeThread(bool ug);
+protected:
+	virtual void run();
+};
+
+DLL_LOCAL void runInRuntime(RuntimeTask & task);
+DLL_LOCAL int convertInRuntime(QObject * owner, wkhtmltopdf::Converter & converter, QSemaphore * & waiter, const bool & succeeded);
+
 class DLL_LOCAL MyPdfConverter: public QObject {
     Q_OBJECT
 public:
@@ -42,6 +76,11 @@ public:
 	wkhtmltopdf_void_callback phase_changed;
 	wkhtmltopdf_int_callback progress_changed;
 	wkhtmltopdf_int_callback finished_cb;
+	wkhtmltopdf_output_callback output_cb;
+	void * output_userdata;
+	// released when the conversion has finished, while another thread waits for it
+	QSemaphore * waiter;
+	bool succeeded;
 
 	wkhtmltopdf::PdfConverter converter;
 
@@ -57,6 +96,7 @@ public slots:
     void phaseChanged();
     void progressChanged(int progress);
     void finished(bool ok);
+	void outputChunk(const QByteArray & data);
 private:
     MyPdfConverter(const MyPdfConverter&);
 };
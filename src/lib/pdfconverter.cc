@@ -26,11 +26,14 @@
 
 #include "pdfconverter_p.hh"
 #include <QAuthenticator>
+#include <QBuffer>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
 #include <QPair>
 #include <QPrintEngine>
+#include <QSet>
+#include <QTextStream>
 #include <QTimer>
 #include <QWebFrame>
 #include <QWebPage>
@@ -38,11 +41,16 @@
 #include <QXmlQuery>
 #include <algorithm>
 #include <qapplication.h>
+#include <qmath.h>
 #include <qfileinfo.h>
 #ifdef Q_OS_WIN32
 #include <fcntl.h>
 #include <io.h>
 #endif
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <linux/falloc.h>
+#endif
 
 #include "dllbegin.inc"
 using namespace wkhtmltopdf;
@@ -84,7 +92,7 @@ PdfConverterPrivate::PdfConverterPrivate(PdfGlobal & s, PdfConverter & o) :
 	settings(s), pageLoader(s.load),
 	out(o), printer(0), painter(0)
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
-    , webPrinter(0), measuringHFLoader(s.load), hfLoader(s.load), tocLoader1(s.load), tocLoader2(s.load)
+    , webPrinter(0), releasePages(false), measuringHFLoader(s.load), hfLoader(s.load), tocLoader1(s.load), tocLoader2(s.load)
 	, tocLoader(&tocLoader1), tocLoaderOld(&tocLoader2)
     , outline(0), currentHeader(0), currentFooter(0)
 #endif
@@ -148,6 +156,7 @@ void PdfConverterPrivate::beginConvert() {
 	progressString = "0%";
 	currentPhase=0;
 	errorCode=0;
+	startTimers(settings.load);
 
 #ifndef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 	if (objects.size() > 1) {
@@ -159,9 +168,32 @@ void PdfConverterPrivate::beginConvert() {
     bool headerHeightsCalcNeeded = false;
 #endif
 
+	//Images never need more pixels than imageDPI allows on the paper
+	int maxImageSize = 0;
+	qreal paperInches = 0;
+	if (settings.downscaleImages) {
+		QPrinter paper(QPrinter::ScreenResolution);
+		if ((settings.size.height.first != -1) && (settings.size.width.first != -1))
+			paper.setPaperSize(QSizeF(settings.size.width.first,settings.size.height.first), settings.size.height.second);
+		else
+			paper.setPaperSize(settings.size.pageSize);
+		QSizeF inches = paper.paperSize(QPrinter::Inch);
+		paperInches = qMax(inches.width(), inches.height());
+		maxImageSize = qCeil(paperInches * settings.imageDPI);
+	}
+
 	for (QList<PageObject>::iterator i=objects.begin(); i != objects.end(); ++i) {
 		PageObject & o=*i;
 		settings::PdfObject & s = o.settings;
+		if (maxImageSize > 0) {
+			//Images without a size in the document are laid out at their own size in css pixels,
+			//so never go below the css pixels the page is laid out on, shrinking included
+			qreal shrink = s.web.enableIntelligentShrinking ? 2.0 : 1.0;
+			int layoutSize = qCeil(paperInches * 96 * shrink / qMax(s.load.zoomFactor, 0.01f));
+			int limit = qMax(maxImageSize, layoutSize);
+			if (s.load.maxImageSize <= 0 || s.load.maxImageSize > limit)
+				s.load.maxImageSize = limit;
+		}
 
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
         if (!s.header.htmlUrl.isEmpty() ) {
@@ -204,7 +236,10 @@ void PdfConverterPrivate::beginConvert() {
 #endif
 
 		if (!s.isTableOfContent) {
-			o.loaderObject = pageLoader.addResource(s.page, s.load, &o.data);
+			if (o.data.isEmpty())
+				o.loaderObject = pageLoader.addResource(s.page, s.load);
+			else
+				o.loaderObject = pageLoader.addResource(o.data, o.baseUrl.isEmpty() ? MultiPageLoader::defaultBaseUrl() : o.baseUrl, s.load);
 			o.page = &o.loaderObject->page;
 			PageObject::webPageToObject[o.page] = &o;
 			updateWebSettings(o.page->settings(), s.web);
@@ -216,8 +251,12 @@ void PdfConverterPrivate::beginConvert() {
 
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
     if (headerHeightsCalcNeeded) {
-        // preload header/footer to check their heights
+        // measure the header/footer heights while the pages load,
+        // the margins are first needed when printing begins
+        pendingLoads = 2;
         measuringHFLoader.load();
+        if (error) return;
+        pageLoader.load();
     } else {
         // set defaults if top or bottom mergin is not specified
         if (settings.margin.top.first == -1) {
@@ -231,9 +270,11 @@ void PdfConverterPrivate::beginConvert() {
         objects[0].headerReserveHeight = settings.margin.top.first;
         objects[0].footerReserveHeight = settings.margin.bottom.first;
 
+        pendingLoads = 1;
         pageLoader.load();
     }
 #else
+    pendingLoads = 1;
     pageLoader.load();
 #endif
 }
@@ -317,7 +358,9 @@ void PdfConverterPrivate::preprocessPage(PageObject & obj) {
 	}
 
 
-	QWebPrinter wp(obj.page->mainFrame(), printer, *painter);
+	//The pagination is kept to print the page with later on
+	obj.webPrinter = new QWebPrinter(obj.page->mainFrame(), printer, *painter);
+	QWebPrinter & wp = *obj.webPrinter;
 	obj.pageCount = obj.settings.pagesCount? wp.pageCount(): 0;
 	pageCount += obj.pageCount;
 
@@ -331,15 +374,25 @@ void PdfConverterPrivate::preprocessPage(PageObject & obj) {
 #endif
 
 /*!
- * Prepares printing out the document to the pdf file
+ * Called when the pages are loaded, printing waits for the header and footer
+ * heights to be measured as well
  */
 void PdfConverterPrivate::pagesLoaded(bool ok) {
+	if (error) return;
 	if (errorCode == 0) errorCode = pageLoader.httpErrorCode();
 	if (!ok) {
 		fail();
 		return;
 	}
 
+	if (--pendingLoads == 0) beginPrint();
+}
+
+/*!
+ * Prepares printing out the document to the pdf file, once the pages are
+ * loaded and the header and footer heights are known
+ */
+void PdfConverterPrivate::beginPrint() {
 	lout = settings.out;
 	if (settings.out == "-") {
 #ifndef Q_OS_WIN32
@@ -347,10 +400,10 @@ void PdfConverterPrivate::pagesLoaded(bool ok) {
 			 lout = "/dev/stdout";
 		 else
 #endif
-			 lout = tempOut.create(".pdf");
+			 lout = tempOut.createInMemory(".pdf");
 	}
 	if (settings.out.isEmpty())
-	  lout = tempOut.create(".pdf");
+	  lout = tempOut.createInMemory(".pdf");
 
 	printer = new QPrinter(settings.resolution);
 	if (settings.dpi != -1) printer->setResolution(settings.dpi);
@@ -441,6 +494,9 @@ void PdfConverterPrivate::pagesLoaded(bool ok) {
 		preprocessPage(objects[d]);
 	actualPages = pageCount * settings.copies;
 
+	tocLoads = 0;
+	tocPatches = 0;
+	tocTimer.start();
 	loadTocs();
 #endif
 }
@@ -458,7 +514,9 @@ void PdfConverterPrivate::loadHeaders() {
 
 		settings::PdfObject & ps = obj.settings;
 		for (int op=0; op < obj.pageCount; ++op) {
-			if (!ps.header.htmlUrl.isEmpty() || !ps.footer.htmlUrl.isEmpty()) {
+			//A template is only loaded once, using the parameters of the first page
+			bool load = !ps.templateHeaderFooter || op == 0;
+			if (load && (!ps.header.htmlUrl.isEmpty() || !ps.footer.htmlUrl.isEmpty())) {
 				QHash<QString, QString> parms;
 				fillParms(parms, pageNumber, obj);
 				parms["sitepage"] = QString::number(op+1);
@@ -475,11 +533,37 @@ void PdfConverterPrivate::loadHeaders() {
 	}
 	if (hf)
 		hfLoader.load();
+	else if (settings.releaseSpooledPages)
+		//Pages are deleted while printing, so leave the signal of the loader first
+		QTimer::singleShot(0, this, SLOT(printDocument()));
 	else
 		printDocument();
 #endif
 }
 
+#ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+/*!
+  \brief Get the compiled query for a TOC style sheet
+
+  Compiled style sheets are kept for the lifetime of the process, and recompiled
+  when the file is modified.
+  \param path The path of the XSL style sheet
+  \returns The query, or 0 if the style sheet could not be read
+*/
+static QXmlQuery * tocQuery(const QString & path) {
+	static QHash<QString, QXmlQuery> queries;
+	QFileInfo info(path);
+	QString key = info.absoluteFilePath() + '\n' + info.lastModified().toString(Qt::ISODate);
+	QHash<QString, QXmlQuery>::iterator i = queries.find(key);
+	if (i != queries.end()) return &i.value();
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) return 0;
+	QXmlQuery query(QXmlQuery::XSLT20);
+	query.setQuery(QString::fromUtf8(file.readAll()), QUrl::fromLocalFile(info.absoluteFilePath()));
+	return &queries.insert(key, query).value();
+}
+#endif
 
 void PdfConverterPrivate::loadTocs() {
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
@@ -492,43 +576,44 @@ void PdfConverterPrivate::loadTocs() {
 		settings::PdfObject & ps = obj.settings;
 		if (!ps.isTableOfContent) continue;
 		obj.clear();
+		delete obj.webPrinter;
+		obj.webPrinter = 0;
+
+		QByteArray html;
+		if (ps.tocXsl.isEmpty()) {
+			//The default style sheet is generated directly, without going through XSLT
+			QTextStream stream(&html);
+			stream.setCodec("UTF-8");
+			outline->dumpDefaultTOC(stream, ps.toc);
+			stream.flush();
+		} else {
+			QXmlQuery * query = tocQuery(ps.tocXsl);
+			if (!query) {
+				emit out.error("Could not read the TOC XSL");
+				fail();
+				return;
+			}
 
-		QString style = ps.tocXsl;
-		if (style.isEmpty()) {
-			style = obj.tocStyleFile.create(".xsl");
-			StreamDumper styleDump(style);
-			dumpDefaultTOCStyleSheet(styleDump.stream, ps.toc);
-		}
-
-		QString path = obj.tocFile.create(".xml");
-		StreamDumper sd(path);
-		outline->dump(sd.stream);
-
-		QFile styleFile(style);
-		if (!styleFile.open(QIODevice::ReadOnly)) {
-			emit out.error("Could not read the TOC XSL");
-			fail();
-		}
-
-		QFile xmlFile(path);
-		if (!xmlFile.open(QIODevice::ReadOnly)) {
-			emit out.error("Could not read the TOC XML");
-			fail();
-		}
-
-		QString htmlPath = obj.tocFile.create(".html");
-		QFile htmlFile(htmlPath);
-		if (!htmlFile.open(QIODevice::WriteOnly)) {
-			emit out.error("Could not open the TOC for writing");
-			fail();
+			QByteArray xml;
+			{
+				QTextStream stream(&xml);
+				stream.setCodec("UTF-8");
+				outline->dump(stream);
+			}
+			QBuffer xmlBuffer(&xml);
+			xmlBuffer.open(QIODevice::ReadOnly);
+			QBuffer htmlBuffer(&html);
+			htmlBuffer.open(QIODevice::WriteOnly);
+			query->setFocus(&xmlBuffer);
+			if (!query->evaluateTo(&htmlBuffer)) {
+				emit out.error("Could not apply the TOC XSL");
+				fail();
+				return;
+			}
 		}
 
-		QXmlQuery query(QXmlQuery::XSLT20);
-		query.setFocus(&xmlFile);
-		query.setQuery(&styleFile);
-		query.evaluateTo(&htmlFile);
-
-		obj.loaderObject = tocLoader->addResource(htmlPath, ps.load);
+		outline->tocPageNumbers(tocPageNumbers);
+		obj.loaderObject = tocLoader->addResource(html, QUrl(), ps.load);
 		obj.page = &obj.loaderObject->page;
 		PageObject::webPageToObject[obj.page] = &obj;
 		updateWebSettings(obj.page->settings(), ps.web);
@@ -540,6 +625,9 @@ void PdfConverterPrivate::loadTocs() {
 			currentPhase = 2;
 			emit out.phaseChanged();
 		}
+		++tocLoads;
+		progressString = QString("Iteration ")+QString::number(tocLoads+tocPatches);
+		emit out.progressChanged(-1);
 		tocLoader->load();
 	} else
 		tocLoaded(true);
@@ -547,12 +635,41 @@ void PdfConverterPrivate::loadTocs() {
 }
 
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+/*!
+ * Index the elements link fragments can point to in a page, in a single pass over the document
+ *
+ * A fragment resolves to the first a element with that name, then the first element with
+ * that id and then the first element with that name. The empty fragment resolves to the body.
+ * \param obj The page to index
+ */
+void PdfConverterPrivate::indexFragments(PageObject & obj) {
+	QHash<QString, QWebElement> ids;
+	QHash<QString, QWebElement> names;
+	obj.fragments[""] = obj.page->mainFrame()->findFirstElement("body");
+	foreach (const QWebElement & elm, obj.page->mainFrame()->findAllElements("*[id], *[name]")) {
+		QString id = elm.attribute("id");
+		if (!id.isEmpty() && !ids.contains(id)) ids[id] = elm;
+		QString name = elm.attribute("name");
+		if (name.isEmpty()) continue;
+		if (elm.tagName().toLower() == "a") {
+			if (!obj.fragments.contains(name)) obj.fragments[name] = elm;
+		} else if (!names.contains(name))
+			names[name] = elm;
+	}
+	for (QHash<QString, QWebElement>::iterator i=ids.begin(); i != ids.end(); ++i)
+		if (!obj.fragments.contains(i.key())) obj.fragments[i.key()] = i.value();
+	for (QHash<QString, QWebElement>::iterator i=names.begin(); i != names.end(); ++i)
+		if (!obj.fragments.contains(i.key())) obj.fragments[i.key()] = i.value();
+}
+
 void PdfConverterPrivate::findLinks(QWebFrame * frame, QVector<QPair<QWebElement, QString> > & local, QVector<QPair<QWebElement, QString> > & external, QHash<QString, QWebElement> & anchors) {
 	bool ulocal=true, uexternal=true;
-	if (PageObject::webPageToObject.contains(frame->page())) {
-		ulocal = PageObject::webPageToObject[frame->page()]->settings.useLocalLinks;
-		uexternal  = PageObject::webPageToObject[frame->page()]->settings.useExternalLinks;
+	PageObject * self = PageObject::webPageToObject.value(frame->page());
+	if (self) {
+		ulocal = self->settings.useLocalLinks;
+		uexternal  = self->settings.useExternalLinks;
 	}
+	QString frameUrl = frame->url().toString(QUrl::RemoveFragment);
 	if (!ulocal && !uexternal) return;
 	foreach (const QWebElement & elm, frame->findAllElements("a")) {
 		QString n=elm.attribute("name");
@@ -567,24 +684,24 @@ void PdfConverterPrivate::findLinks(QWebFrame * frame, QVector<QPair<QWebElement
 			QUrl href(h);
 			if (href.isEmpty()) continue;
 			href=frame->baseUrl().resolved(href);
-			if (urlToPageObj.contains(href.toString(QUrl::RemoveFragment))) {
-				if (ulocal) {
-					PageObject * p = urlToPageObj[href.toString(QUrl::RemoveFragment)];
-					QWebElement e;
-					if (!href.hasFragment())
-						e = p->page->mainFrame()->findFirstElement("body");
-					else {
-						e = p->page->mainFrame()->findFirstElement("a[name=\""+href.fragment()+"\"]");
-						if (e.isNull())
-							e = p->page->mainFrame()->findFirstElement("*[id=\""+href.fragment()+"\"]");
-						if (e.isNull())
-							e = p->page->mainFrame()->findFirstElement("*[name=\""+href.fragment()+"\"]");
-					}
+			QString url = href.toString(QUrl::RemoveFragment);
+			//Objects loaded from memory can share their url, so a link to the
+			//url of its own frame stays within its own object
+			PageObject * p = (self && url == frameUrl) ? self : urlToPageObj.value(url);
+			if (p) {
+				//The page might already have been printed and released
+				if (ulocal && p->page) {
+					if (p->fragments.isEmpty()) indexFragments(*p);
+					QWebElement e = p->fragments.value(href.fragment());
 					if (!e.isNull()) {
-						p->anchors[href.toString()] = e;
-						local.push_back( qMakePair(elm, href.toString()) );
+						//Anchors of objects sharing their url are told apart by the object
+						QString name = href.toString();
+						if (urlToPageObj.value(url) != p) name = QString("%1:%2").arg(p->number).arg(name);
+						p->anchors[name] = e;
+						local.push_back( qMakePair(elm, name) );
 					}
-				}
+				} else if (ulocal)
+					forwardWarning(QString("Link to %1 dropped, its page was already printed and released").arg(href.toString()));
 			} else if (uexternal) {
 				// pass the unresolved url to WebKit. WebKit will resolve it
 				// depending upon the type of url - filepath, web-uri etc.
@@ -610,9 +727,14 @@ void PdfConverterPrivate::endPage(PageObject & object, bool hasHeaderFooter, int
     // save margin values
     qreal leftMargin, topMargin, rightMargin, bottomMargin;
     printer->getPageMargins(&leftMargin, &topMargin, &rightMargin, &bottomMargin, settings.margin.left.second);
-	if (hasHeaderFooter) {
-		QHash<QString, QString> parms;
+	QHash<QString, QString> parms;
+	if (hasHeaderFooter || s.templateHeaderFooter) {
 		fillParms(parms, pageNumber, object);
+		parms["sitepage"] = QString::number(objectPage+1);
+		parms["sitepages"] = QString::number(object.pageCount);
+	}
+
+	if (hasHeaderFooter) {
 
 		//Webkit used all kinds of crazy coordinate transformation, and font setup
 		//We save it here and restore some sane defaults
@@ -655,6 +777,8 @@ void PdfConverterPrivate::endPage(PageObject & object, bool hasHeaderFooter, int
 	if (currentHeader) {
 		QWebPage * header = currentHeader;
 		updateWebSettings(header->settings(), object.settings.web);
+		if (s.templateHeaderFooter)
+			instantiateHeaderFooter(header, object.headerTemplate, parms);
 		painter->save();
 		painter->resetTransform();
 		double spacing = s.header.spacing * printer->height() / printer->heightMM();
@@ -684,6 +808,8 @@ void PdfConverterPrivate::endPage(PageObject & object, bool hasHeaderFooter, int
 	if (currentFooter) {
 		QWebPage * footer=currentFooter;
 		updateWebSettings(footer->settings(), object.settings.web);
+		if (s.templateHeaderFooter)
+			instantiateHeaderFooter(footer, object.footerTemplate, parms);
 		painter->save();
 		painter->resetTransform();
 		double spacing = s.footer.spacing * printer->height() / printer->heightMM();
@@ -715,7 +841,9 @@ void PdfConverterPrivate::endPage(PageObject & object, bool hasHeaderFooter, int
 
 void PdfConverterPrivate::handleTocPage(PageObject & obj) {
 	painter->save();
-	QWebPrinter wp(obj.page->mainFrame(), printer, *painter);
+	delete obj.webPrinter;
+	obj.webPrinter = new QWebPrinter(obj.page->mainFrame(), printer, *painter);
+	QWebPrinter & wp = *obj.webPrinter;
 	int pc = obj.settings.pagesCount? wp.pageCount(): 0;
 	if (pc != obj.pageCount) {
 		obj.pageCount = pc;
@@ -725,6 +853,51 @@ void PdfConverterPrivate::handleTocPage(PageObject & obj) {
 	tocChanged = outline->replaceWebPage(obj.number, obj.settings.toc.captionText, wp, obj.page->mainFrame(), obj.settings, obj.localLinks, obj.anchors) || tocChanged;
 	painter->restore();
 }
+
+/*!
+ * Bring the loaded tables of content up to date by changing the page numbers in place,
+ * instead of generating and loading them again.
+ *
+ * This is only possible when the structure of the outline did not change, and the
+ * default style sheet, whose markup we know, is used.
+ * \returns True if all tables of content were patched
+ */
+bool PdfConverterPrivate::patchTocs() {
+	QList<QPair<QString, QString> > pages;
+	outline->tocPageNumbers(pages);
+	if (pages.size() != tocPageNumbers.size()) return false;
+	for (int i=0; i < pages.size(); ++i)
+		if (pages[i].first != tocPageNumbers[i].first) return false;
+
+	for (int d=0; d < objects.size(); ++d) {
+		PageObject & obj = objects[d];
+		if (!obj.settings.isTableOfContent || !obj.loaderObject || obj.loaderObject->skip) continue;
+		if (!obj.settings.tocXsl.isEmpty()) return false;
+	}
+
+	for (int d=0; d < objects.size(); ++d) {
+		PageObject & obj = objects[d];
+		if (!obj.settings.isTableOfContent || !obj.loaderObject || obj.loaderObject->skip) continue;
+		//The default style sheet puts the page number in a span following the link
+		QHash<QString, QWebElement> links;
+		foreach (const QWebElement & elm, obj.page->mainFrame()->findAllElements("a[name]"))
+			links[elm.attribute("name")] = elm;
+		for (int i=0; i < pages.size(); ++i) {
+			if (pages[i].second == tocPageNumbers[i].second) continue;
+			QWebElement span = links.value(pages[i].first).nextSibling();
+			if (span.tagName() == "SPAN")
+				span.setPlainText(" "+pages[i].second+" ");
+		}
+		obj.anchors.clear();
+		obj.localLinks.clear();
+		obj.externalLinks.clear();
+	}
+	tocPageNumbers = pages;
+	++tocPatches;
+	progressString = QString("Iteration ")+QString::number(tocLoads+tocPatches);
+	emit out.progressChanged(-1);
+	return true;
+}
 #endif
 
 
@@ -737,40 +910,62 @@ void PdfConverterPrivate::tocLoaded(bool ok) {
 		return;
 	}
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
-	tocChanged = false;
-	pageCount = 0;
-	currentObject = 0;
-	for (int d=0; d < objects.size(); ++d) {
-		++currentObject;
-		if (!objects[d].loaderObject || objects[d].loaderObject->skip) continue;
-		if (!objects[d].settings.isTableOfContent) {
-			pageCount += objects[d].pageCount;
-			continue;
+	do {
+		tocChanged = false;
+		pageCount = 0;
+		currentObject = 0;
+		for (int d=0; d < objects.size(); ++d) {
+			++currentObject;
+			if (!objects[d].loaderObject || objects[d].loaderObject->skip) continue;
+			if (!objects[d].settings.isTableOfContent) {
+				pageCount += objects[d].pageCount;
+				continue;
+			}
+			handleTocPage(objects[d]);
 		}
-		handleTocPage(objects[d]);
-	}
+	} while (tocChanged && patchTocs());
 
 	actualPages = pageCount * settings.copies;
 	if (tocChanged)
 		loadTocs();
 	else {
+		if (tocLoads != 0) {
+			progressString = QString::number(tocLoads+tocPatches) + " iterations, " +
+				QString::number(tocLoads) + " loaded and " + QString::number(tocPatches) +
+				" patched in " + QString::number(tocTimer.elapsed()) + " ms";
+			emit out.progressChanged(100);
+		}
+
 		//Find and resolve all local links
 		currentPhase = 3;
 		emit out.phaseChanged();
 
 		QHash<QString, int> urlToDoc;
+		//Urls shared by several objects, such as the base url of objects
+		//loaded from memory, cannot tell the objects apart and are left out
+		QSet<QString> sharedUrls;
 		for (int d=0; d < objects.size(); ++d) {
 			if (!objects[d].loaderObject || objects[d].loaderObject->skip) continue;
 			if (objects[d].settings.isTableOfContent) continue;
-			urlToPageObj[ objects[d].page->mainFrame()->url().toString(QUrl::RemoveFragment) ] = &objects[d];
+			QString url = objects[d].page->mainFrame()->url().toString(QUrl::RemoveFragment);
+			if (urlToPageObj.contains(url)) sharedUrls.insert(url);
+			urlToPageObj[url] = &objects[d];
 		}
+		foreach (const QString & url, sharedUrls)
+			urlToPageObj.remove(url);
 
+		QElapsedTimer linkTimer;
+		linkTimer.start();
+		int links = 0;
 		for (int d=0; d < objects.size(); ++d) {
 			if (!objects[d].loaderObject || objects[d].loaderObject->skip) continue;
 			progressString = QString("Object ")+QString::number(d+1)+QString(" of ")+QString::number(objects.size());
 			emit out.progressChanged((d+1)*100 / objects.size());
 			findLinks(objects[d].page->mainFrame(), objects[d].localLinks, objects[d].externalLinks, objects[d].anchors );
+			links += objects[d].localLinks.size() + objects[d].externalLinks.size();
 		}
+		progressString = QString::number(links) + " links resolved in " + QString::number(linkTimer.elapsed()) + " ms";
+		emit out.progressChanged(100);
 
 		loadHeaders();
 	}
@@ -779,6 +974,7 @@ void PdfConverterPrivate::tocLoaded(bool ok) {
 
 
 void PdfConverterPrivate::measuringHeadersLoaded(bool ok) {
+    if (error) return;
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
     if (errorCode == 0) errorCode = measuringHFLoader.httpErrorCode();
 #endif
@@ -802,7 +998,7 @@ void PdfConverterPrivate::measuringHeadersLoaded(bool ok) {
     }
 #endif
 
-    pageLoader.load();
+    if (--pendingLoads == 0) beginPrint();
 }
 
 void PdfConverterPrivate::headersLoaded(bool ok) {
@@ -813,6 +1009,22 @@ void PdfConverterPrivate::headersLoaded(bool ok) {
 		fail();
 		return;
 	}
+#ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+	//Remember the markup of the templates before the first page changes it
+	for (int d=0; d < objects.size(); ++d) {
+		PageObject & obj = objects[d];
+		if (!obj.settings.templateHeaderFooter) continue;
+		if (!obj.headers.empty())
+			obj.headerTemplate = obj.headers[0]->mainFrame()->findFirstElement("body").toInnerXml();
+		if (!obj.footers.empty())
+			obj.footerTemplate = obj.footers[0]->mainFrame()->findFirstElement("body").toInnerXml();
+	}
+	if (settings.releaseSpooledPages) {
+		//Pages are deleted while printing, so leave the signal of the loader first
+		QTimer::singleShot(0, this, SLOT(printDocument()));
+		return;
+	}
+#endif
 	printDocument();
 }
 
@@ -825,13 +1037,15 @@ void PdfConverterPrivate::spoolPage(int page) {
 		printer->newPage();
 
 	webPrinter->spoolPage(page+1);
-	foreach (QWebElement elm, pageFormElements[page+1]) {
+	typedef QPair<QWebElement, QRectF> form_t;
+	foreach (const form_t & form, pageFormElements[page+1]) {
+		QWebElement elm = form.first;
 		QString type = elm.attribute("type");
 		QString tn = elm.tagName();
 		QString name = elm.attribute("name");
 		if (tn == "TEXTAREA" || type == "text" || type == "password") {
 			painter->addTextField(
-				webPrinter->elementLocation(elm).second,
+				form.second,
 				tn == "TEXTAREA"?elm.toPlainText():elm.attribute("value"),
 				name,
 				tn == "TEXTAREA",
@@ -841,41 +1055,42 @@ void PdfConverterPrivate::spoolPage(int page) {
 				);
 		} else if (type == "checkbox") {
 			painter->addCheckBox(
-				webPrinter->elementLocation(elm).second,
+				form.second,
 				elm.evaluateJavaScript("this.checked;").toBool(),
 				name,
 				elm.evaluateJavaScript("this.readonly;").toBool());
 		}
 	}
-	for (QHash<QString, QWebElement>::iterator i=pageAnchors[page+1].begin();
-		 i != pageAnchors[page+1].end(); ++i) {
-		QRectF r = webPrinter->elementLocation(i.value()).second;
-		painter->addAnchor(r, i.key());
-	}
-	for (QVector< QPair<QWebElement,QString> >::iterator i=pageLocalLinks[page+1].begin();
-		 i != pageLocalLinks[page+1].end(); ++i) {
-		QRectF r = webPrinter->elementLocation(i->first).second;
-		painter->addLink(r, i->second);
-	}
-	for (QVector< QPair<QWebElement,QString> >::iterator i=pageExternalLinks[page+1].begin();
-		 i != pageExternalLinks[page+1].end(); ++i) {
-		QRectF r = webPrinter->elementLocation(i->first).second;
-		painter->addHyperlink(r, QUrl(i->second));
-	}
+	for (QHash<QString, QRectF>::iterator i=pageAnchors[page+1].begin();
+		 i != pageAnchors[page+1].end(); ++i)
+		painter->addAnchor(i.value(), i.key());
+	for (QVector< QPair<QRectF,QString> >::iterator i=pageLocalLinks[page+1].begin();
+		 i != pageLocalLinks[page+1].end(); ++i)
+		painter->addLink(i->first, i->second);
+	for (QVector< QPair<QRectF,QString> >::iterator i=pageExternalLinks[page+1].begin();
+		 i != pageExternalLinks[page+1].end(); ++i)
+		painter->addHyperlink(i->first, QUrl(i->second));
 	endPage(objects[currentObject], pageHasHeaderFooter, page, pageNumber);
 	actualPage++;
+	flushOutput();
 }
 
 void PdfConverterPrivate::spoolTo(int page) {
 	int pc=settings.collate?1:settings.copies;
 	const settings::PdfObject & ps = objects[currentObject].settings;
 	while (objectPage < page) {
+		if (stopPending()) return;
 		for (int pc_=0; pc_ < pc; ++pc_)
 			spoolPage(objectPage);
 		if (ps.pagesCount) ++pageNumber;
 		++objectPage;
 
-		//TODO free header and footer
+		//Headers and footers are not needed once their page is spooled,
+		//templates are released with the object
+		if (releasePages && !ps.templateHeaderFooter) {
+			if (currentHeader) hfLoader.releaseResource(currentHeader);
+			if (currentFooter) hfLoader.releaseResource(currentFooter);
+		}
 		currentHeader=NULL;
 		currentFooter=NULL;
 	}
@@ -902,30 +1117,42 @@ void PdfConverterPrivate::beginPrintObject(PageObject & obj) {
 	}
 
 	//output
-	webPrinter = new QWebPrinter(obj.page->mainFrame(), printer, *painter);
+	//Print with the pagination from counting the pages, unless it was used by an earlier copy
+	if (obj.webPrinter) {
+		webPrinter = obj.webPrinter;
+		obj.webPrinter = 0;
+	} else
+		webPrinter = new QWebPrinter(obj.page->mainFrame(), printer, *painter);
 	QString l1=obj.page->mainFrame()->url().path().split("/").back()+"#";
 	QString l2=obj.page->mainFrame()->url().toString() + "#";
 
 	outline->fillAnchors(obj.number, obj.anchors);
 
-	//Sort anchors and links by page
+	//Sort anchors and links by page, the location of every element is looked up once
+	//here, as the layout does not change while the object is printed
 	for (QHash<QString, QWebElement>::iterator i=obj.anchors.begin();
-		 i != obj.anchors.end(); ++i)
-		pageAnchors[webPrinter->elementLocation(i.value()).first][i.key()] = i.value();
+		 i != obj.anchors.end(); ++i) {
+		QPair<int, QRectF> location = webPrinter->elementLocation(i.value());
+		pageAnchors[location.first][i.key()] = location.second;
+	}
 
 	for (QVector< QPair<QWebElement,QString> >::iterator i=obj.localLinks.begin();
-		 i != obj.localLinks.end(); ++i)
-		pageLocalLinks[webPrinter->elementLocation(i->first).first].push_back(*i);
+		 i != obj.localLinks.end(); ++i) {
+		QPair<int, QRectF> location = webPrinter->elementLocation(i->first);
+		pageLocalLinks[location.first].push_back(qMakePair(location.second, i->second));
+	}
 
 	for (QVector< QPair<QWebElement,QString> >::iterator i=obj.externalLinks.begin();
-		 i != obj.externalLinks.end(); ++i)
-		pageExternalLinks[webPrinter->elementLocation(i->first).first].push_back(*i);
+		 i != obj.externalLinks.end(); ++i) {
+		QPair<int, QRectF> location = webPrinter->elementLocation(i->first);
+		pageExternalLinks[location.first].push_back(qMakePair(location.second, i->second));
+	}
 
 	if (ps.produceForms) {
-		foreach (const QWebElement & elm, obj.page->mainFrame()->findAllElements("input"))
-			pageFormElements[webPrinter->elementLocation(elm).first].push_back(elm);
-		foreach (const QWebElement & elm, obj.page->mainFrame()->findAllElements("textarea"))
-			pageFormElements[webPrinter->elementLocation(elm).first].push_back(elm);
+		foreach (const QWebElement & elm, obj.page->mainFrame()->findAllElements("input, textarea")) {
+			QPair<int, QRectF> location = webPrinter->elementLocation(elm);
+			pageFormElements[location.first].push_back(qMakePair(elm, location.second));
+		}
 	}
 	emit out.producingForms(obj.settings.produceForms);
 	out.emitCheckboxSvgs(obj.settings.load);
@@ -962,11 +1189,37 @@ void PdfConverterPrivate::endPrintObject(PageObject & obj) {
 		painter->restore();
 	}
 
+	if (releasePages) {
+		//Everything of this object has been spooled, free its pages
+		if (obj.settings.templateHeaderFooter) {
+			foreach (QWebPage * page, obj.headers) hfLoader.releaseResource(page);
+			foreach (QWebPage * page, obj.footers) hfLoader.releaseResource(page);
+		}
+		obj.headers.clear();
+		obj.footers.clear();
+		if (obj.measuringHeader) measuringHFLoader.releaseResource(obj.measuringHeader);
+		if (obj.measuringFooter) measuringHFLoader.releaseResource(obj.measuringFooter);
+		obj.measuringHeader = 0;
+		obj.measuringFooter = 0;
+		if (obj.page) {
+			obj.anchors.clear();
+			obj.localLinks.clear();
+			obj.externalLinks.clear();
+			obj.fragments.clear();
+			PageObject::webPageToObject.remove(obj.page);
+			if (!pageLoader.releaseResource(obj.page))
+				tocLoader->releaseResource(obj.page);
+			obj.page = 0;
+			obj.loaderObject = 0;
+		}
+	}
 }
 
 #endif
 
 void PdfConverterPrivate::printDocument() {
+	//A cancel or deadline while printing is carried out by endPrinting, once the loops below are left
+	printing = true;
 #ifndef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 	currentPhase = 1;
 	emit out.phaseChanged();
@@ -977,6 +1230,8 @@ void PdfConverterPrivate::printDocument() {
 	actualPage=1;
 
  	int cc=settings.collate?settings.copies:1;
+	//Collated copies print every object more than once
+	releasePages = settings.releaseSpooledPages && cc == 1;
 
 
 	currentPhase = 5;
@@ -985,34 +1240,44 @@ void PdfConverterPrivate::printDocument() {
 	progressString = "Preparing";
 	emit out.progressChanged(0);
 
-	for (int cc_=0; cc_ < cc; ++cc_) {
+	for (int cc_=0; cc_ < cc && !stopPending(); ++cc_) {
 		pageNumber=1;
-		for (int d=0; d < objects.size(); ++d) {
+		for (int d=0; d < objects.size() && !stopPending(); ++d) {
 			beginPrintObject(objects[d]);
 			// XXX: In some cases nothing gets loaded at all,
 			//      so we would get no webPrinter instance.
 			int pageCount = webPrinter != 0 ? webPrinter->pageCount() : 0;
 			//const settings::PdfObject & ps = objects[d].settings;
 
-			for(int i=0; i < pageCount; ++i) {
+			for(int i=0; i < pageCount && !stopPending(); ++i) {
+				int hf = objects[d].settings.templateHeaderFooter ? 0 : i;
 				if (!objects[d].headers.empty())
-					handleHeader(objects[d].headers[i], i);
+					handleHeader(objects[d].headers[hf], i);
 				if (!objects[d].footers.empty())
-					handleFooter(objects[d].footers[i], i);
+					handleFooter(objects[d].footers[hf], i);
 			}
 
 		}
+		if (stopPending()) break;
 		endPrintObject(objects[objects.size()-1]);
  	}
-	outline->printOutline(printer);
+	if (stopPending()) {
+		//The object being printed when stopping was never ended
+		delete webPrinter;
+		webPrinter = 0;
+	} else {
+		outline->printOutline(printer);
 
-	if (!settings.dumpOutline.isEmpty()) {
-		StreamDumper sd(settings.dumpOutline);
-		outline->dump(sd.stream);
+		if (!settings.dumpOutline.isEmpty()) {
+			StreamDumper sd(settings.dumpOutline);
+			outline->dump(sd.stream);
+		}
 	}
 
  	painter->end();
 #endif
+	if (endPrinting()) return;
+
 	if (settings.out == "-" && lout != "/dev/stdout") {
 		QFile i(lout);
 		QFile o;
@@ -1028,13 +1293,20 @@ void PdfConverterPrivate::printDocument() {
 		}
 	}
 
-	if (settings.out.isEmpty()) {
+	if (settings.out.isEmpty() && streamOutput) {
+		flushOutput();
+		outputStream.close();
+		tempOut.remove();
+	} else if (settings.out.isEmpty()) {
 		QFile i(lout);
 		if (!i.open(QIODevice::ReadOnly)) {
 			emit out.error("Reading output failed");
 			fail();
+			return;
 		}
 		outputData = i.readAll();
+		i.close();
+		tempOut.remove();
 	}
 	clearResources();
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
@@ -1045,8 +1317,27 @@ void PdfConverterPrivate::printDocument() {
 	emit out.phaseChanged();
 	convertionDone = true;
 	emit out.finished(true);
+}
 
-	qApp->exit(0); // quit qt's event handling
+/*!
+ * When streaming, hand the output written by the printer so far to the
+ * outputChunk signal
+ */
+void PdfConverterPrivate::flushOutput() {
+	if (!streamOutput || !settings.out.isEmpty()) return;
+	if (!outputStream.isOpen()) {
+		outputStream.setFileName(lout);
+		if (!outputStream.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) return;
+	}
+	QByteArray chunk;
+	chunk.resize(1024*64);
+	qint64 r;
+	while ((r = outputStream.read(chunk.data(), chunk.size())) > 0)
+		emitOutput(chunk.left(r));
+#ifdef Q_OS_LINUX
+	//What has been handed out is not needed any more, give the memory back
+	fallocate(outputStream.handle(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, outputStream.pos());
+#endif
 }
 
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
@@ -1068,12 +1359,40 @@ QString PdfConverterPrivate::hfreplace(const QString & q, const QHash<QString, Q
 		r=r.replace("["+i.key()+"]", i.value(), Qt::CaseInsensitive);
 	return r;
 }
+
+/*!
+ * Instantiate a header or footer template for the page currently being printed
+ *
+ * The body of the already loaded page is reset to the template markup with the
+ * variables substituted, and elements with a class named after a variable get
+ * the value as text, like the subst() function from the manual would do.
+ * \param page The loaded header or footer page
+ * \param markup The body markup of the template
+ * \param parms The variables of the current page
+ */
+void PdfConverterPrivate::instantiateHeaderFooter(QWebPage * page, const QString & markup, const QHash<QString, QString> & parms) {
+	QHash<QString, QString> escaped;
+	for (QHash<QString, QString>::const_iterator i=parms.begin(); i != parms.end(); ++i)
+		escaped[i.key()] = escape(i.value());
+	QWebFrame * frame = page->mainFrame();
+	frame->findFirstElement("body").setInnerXml(hfreplace(markup, escaped));
+	for (QHash<QString, QString>::const_iterator i=parms.begin(); i != parms.end(); ++i)
+		foreach (QWebElement elm, frame->findAllElements("."+i.key()))
+			elm.setPlainText(i.value());
+}
 #endif
 
 void PdfConverterPrivate::clearResources() {
+#ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+	for (int d=0; d < objects.size(); ++d) {
+		delete objects[d].webPrinter;
+		objects[d].webPrinter = 0;
+	}
+#endif
 	objects.clear();
 	pageLoader.clearResources();
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+	measuringHFLoader.clearResources();
 	hfLoader.clearResources();
 	tocLoader1.clearResources();
 	tocLoader2.clearResources();
@@ -1097,6 +1416,10 @@ void PdfConverterPrivate::clearResources() {
 		painter = 0;
 		delete tmp;
 	}
+
+	//A failed conversion leaves the output it has written so far behind
+	if (outputStream.isOpen()) outputStream.close();
+	tempOut.remove();
 }
 
 Converter & PdfConverterPrivate::outer() {
@@ -1131,7 +1454,16 @@ PdfConverter::~PdfConverter() {
   \param url The url of the object we want to convert
 */
 void PdfConverter::addResource(const settings::PdfObject & page, const QString * data) {
-  d->objects.push_back( PageObject(page, data) );
+  addResource(page, data ? data->toUtf8() : QByteArray(), QUrl());
+}
+
+/*!
+  \brief add a resource we want to convert, from html kept in memory
+  \param data The utf-8 encoded html to convert, if empty the page setting is loaded instead
+  \param baseUrl The url relative references resolve against, if empty the working directory is used
+*/
+void PdfConverter::addResource(const settings::PdfObject & page, const QByteArray & data, const QUrl & baseUrl) {
+  d->objects.push_back( PageObject(page, data, baseUrl) );
   d->objects.back().number = d->objects.size()-1;
 }
 
@@ -33,6 +33,7 @@
 #include "pdfsettings.hh"
 #include "tempfile.hh"
 #include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QMutex>
 #include <QPainter>
@@ -55,13 +56,18 @@ public:
 	settings::PdfObject settings;
 	LoaderObject * loaderObject;
 	QWebPage * page;
-	QString data;
+	//Utf-8 encoded html to convert instead of loading the page setting
+	QByteArray data;
+	//Url relative references in data resolve against
+	QUrl baseUrl;
 	int number;
 
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 	QHash<QString, QWebElement> anchors;
 	QVector< QPair<QWebElement,QString> > localLinks;
 	QVector< QPair<QWebElement,QString> > externalLinks;
+	// elements that link fragments resolve to, "" maps to the body
+	QHash<QString, QWebElement> fragments;
     // height length to reserve for header when printing page
     double headerReserveHeight;
     // height length to reserve for footer when printing page
@@ -70,37 +76,37 @@ public:
     QWebPage * measuringHeader;
     // keeps preloaded footer to calculate header height
     QWebPage * measuringFooter;
+	// pagination done when counting the pages, handed on to printing
+	QWebPrinter * webPrinter;
+	// body markup of the header and footer when they are instantiated per page
+	QString headerTemplate;
+	QString footerTemplate;
 #endif
 
 	int firstPageNumber;
 	QList<QWebPage *> headers;
 	QList<QWebPage *> footers;
 	int pageCount;
-	TempFile tocStyleFile;
-	TempFile tocFile;
 
 	void clear() {
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 		anchors.clear();
 		localLinks.clear();
 		externalLinks.clear();
+		fragments.clear();
 #endif
 		headers.clear();
 		footers.clear();
 		webPageToObject.remove(page);
  		page=0;
-		tocStyleFile.remove();
-		tocFile.remove();
 	}
 
-	PageObject(const settings::PdfObject & set, const QString * d=NULL):
-		settings(set), loaderObject(0), page(0)
+	PageObject(const settings::PdfObject & set, const QByteArray & d=QByteArray(), const QUrl & base=QUrl()):
+		settings(set), loaderObject(0), page(0), data(d), baseUrl(base)
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
-		, headerReserveHeight(0), footerReserveHeight(0), measuringHeader(0), measuringFooter(0)
+		, headerReserveHeight(0), footerReserveHeight(0), measuringHeader(0), measuringFooter(0), webPrinter(0)
 #endif
-	{
-		if (d) data=*d;
-	};
+	{};
 
 	~PageObject() {
 		clear();
@@ -123,6 +129,8 @@ private:
 	void clearResources();
 	TempFile tempOut;
 	QByteArray outputData;
+	QFile outputStream;
+	void flushOutput();
 
 	QList<PageObject> objects;
 	QSize viewportSize;
@@ -137,16 +145,21 @@ private:
 	bool tocChanged;
 	int actualPage;
 	int pageNumber;
+	// loaders that have to finish before printing can begin
+	int pendingLoads;
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 	QWebPrinter * webPrinter;
 	int objectPage;
 
 
-	QHash<int, QHash<QString, QWebElement> > pageAnchors;
-	QHash<int, QVector< QPair<QWebElement,QString> > > pageLocalLinks;
-	QHash<int, QVector< QPair<QWebElement,QString> > > pageExternalLinks;
-	QHash<int, QVector<QWebElement> > pageFormElements;
+	// anchors, links and form elements of the current object by page,
+	// located once with webPrinter when the object is begun
+	QHash<int, QHash<QString, QRectF> > pageAnchors;
+	QHash<int, QVector< QPair<QRectF,QString> > > pageLocalLinks;
+	QHash<int, QVector< QPair<QRectF,QString> > > pageExternalLinks;
+	QHash<int, QVector< QPair<QWebElement,QRectF> > > pageFormElements;
 	bool pageHasHeaderFooter;
+	bool releasePages;
 	
     // loader for measuringHeader and measuringFooter
     MultiPageLoader measuringHFLoader;
@@ -158,13 +171,21 @@ private:
 	MultiPageLoader * tocLoader;
 	MultiPageLoader * tocLoaderOld;
 
+	// page numbers the loaded tables of content show, see Outline::tocPageNumbers
+	QList<QPair<QString, QString> > tocPageNumbers;
+	int tocLoads;
+	int tocPatches;
+	QElapsedTimer tocTimer;
+
 	QHash<QString, PageObject *> urlToPageObj;
 
 	Outline * outline;
+	void indexFragments(PageObject & obj);
 	void findLinks(QWebFrame * frame, QVector<QPair<QWebElement, QString> > & local, QVector<QPair<QWebElement, QString> > & external, QHash<QString, QWebElement> & anchors);
 	void endPage(PageObject & object, bool hasHeaderFooter, int objectPage,  int pageNumber);
 	void fillParms(QHash<QString, QString> & parms, int page, const PageObject & object);
 	QString hfreplace(const QString & q, const QHash<QString, QString> & parms);
+	void instantiateHeaderFooter(QWebPage * page, const QString & markup, const QHash<QString, QString> & parms);
 	QWebPage * loadHeaderFooter(QString url, const QHash<QString, QString> & parms, const settings::PdfObject & ps);
     qreal calculateHeaderHeight(PageObject & object, QWebPage & header);
 
@@ -175,6 +196,7 @@ private:
 
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 	void handleTocPage(PageObject & obj);
+	bool patchTocs();
 	void preprocessPage(PageObject & obj);
 	void spoolPage(int page);
 	void spoolTo(int page);
@@ -186,6 +208,7 @@ private:
 
 	void loadTocs();
 	void loadHeaders();
+	void beginPrint();
 public slots:
     void measuringHeadersLoaded(bool ok);
     void pagesLoaded(bool ok);
@@ -130,6 +130,8 @@ struct DLL_LOCAL ReflectImpl<PdfGlobal>: public ReflectClass {
         WKHTMLTOPDF_REFLECT(imageDPI);
         WKHTMLTOPDF_REFLECT(imageQuality);
         WKHTMLTOPDF_REFLECT(useNativeFormatPrinter);
+		WKHTMLTOPDF_REFLECT(releaseSpooledPages);
+		WKHTMLTOPDF_REFLECT(downscaleImages);
         WKHTMLTOPDF_REFLECT(load);
 	}
 };
@@ -155,6 +157,7 @@ struct DLL_LOCAL ReflectImpl<PdfObject>: public ReflectClass {
 		WKHTMLTOPDF_REFLECT(page);
 		WKHTMLTOPDF_REFLECT(header);
 		WKHTMLTOPDF_REFLECT(footer);
+		WKHTMLTOPDF_REFLECT(templateHeaderFooter);
 		WKHTMLTOPDF_REFLECT(useExternalLinks);
 		WKHTMLTOPDF_REFLECT(useLocalLinks);
 		WKHTMLTOPDF_REFLECT(replacements);
@@ -389,7 +392,9 @@ PdfGlobal::PdfGlobal():
     imageDPI(600),
     imageQuality(94),
     useNativeFormatPrinter(false),
-    viewportSize(""){};
+    viewportSize(""),
+    releaseSpooledPages(false),
+    downscaleImages(false) {};
 
 TableOfContent::TableOfContent():
 	useDottedLines(true),
@@ -400,6 +405,7 @@ TableOfContent::TableOfContent():
 	fontScale(0.8) {}
 
 PdfObject::PdfObject():
+	templateHeaderFooter(false),
 	useExternalLinks(true),
 	useLocalLinks(true),
 	produceForms(false),
@@ -143,6 +143,12 @@ struct DLL_PUBLIC PdfGlobal {
 
 	bool useNativeFormatPrinter; // use QPrinter::NativeFormat on Mac OS X?
 
+	//! Free pages, headers and footers as soon as they have been printed
+	bool releaseSpooledPages;
+
+	//! Downscale images when they are downloaded, to what imageDPI allows on the paper size
+	bool downscaleImages;
+
 	LoadGlobal load;
 
 	QString get(const char * name);
@@ -183,6 +189,9 @@ struct DLL_PUBLIC PdfObject {
 	//! Header related settings
 	HeaderFooter footer;
 
+	//! Load html headers and footers once and instantiate them for every page
+	bool templateHeaderFooter;
+
 	//! Should external links be links in the PDF
 	bool useExternalLinks;
 
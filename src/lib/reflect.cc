@@ -57,6 +57,9 @@ ReflectClass::~ReflectClass() {
 
 ReflectImpl<LoadGlobal>::ReflectImpl(LoadGlobal & c) {
 	WKHTMLTOPDF_REFLECT(cookieJar);
+	WKHTMLTOPDF_REFLECT(memoryCacheSize);
+	WKHTMLTOPDF_REFLECT(jobTimeout);
+	WKHTMLTOPDF_REFLECT(phaseTimeout);
 }
 
 ReflectImpl<LoadPage>::ReflectImpl(LoadPage & c) {
@@ -64,6 +67,13 @@ ReflectImpl<LoadPage>::ReflectImpl(LoadPage & c) {
 	WKHTMLTOPDF_REFLECT(password);
 	WKHTMLTOPDF_REFLECT(jsdelay);
 	WKHTMLTOPDF_REFLECT(windowStatus);
+	WKHTMLTOPDF_REFLECT(networkIdle);
+	WKHTMLTOPDF_REFLECT(waitForReady);
+	WKHTMLTOPDF_REFLECT(maxLoadWait);
+	WKHTMLTOPDF_REFLECT(resourceTimeout);
+	WKHTMLTOPDF_REFLECT(hostConnections);
+	WKHTMLTOPDF_REFLECT(httpPipelining);
+	WKHTMLTOPDF_REFLECT(maxImageSize);
 	WKHTMLTOPDF_REFLECT(zoomFactor);
 	WKHTMLTOPDF_REFLECT(customHeaders);
 	WKHTMLTOPDF_REFLECT(repeatCustomHeaders);
@@ -81,6 +91,8 @@ ReflectImpl<LoadPage>::ReflectImpl(LoadPage & c) {
 	WKHTMLTOPDF_REFLECT(radiobuttonSvg);
 	WKHTMLTOPDF_REFLECT(radiobuttonCheckedSvg);
 	WKHTMLTOPDF_REFLECT(cacheDir);
+	WKHTMLTOPDF_REFLECT(immutableHosts);
+	WKHTMLTOPDF_REFLECT(urlMappings);
 }
 
 ReflectImpl<Web>::ReflectImpl(Web & c) {
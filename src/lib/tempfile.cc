@@ -28,6 +28,10 @@
 #include <QDir>
 #include <QFile>
 #include <QUuid>
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "dllbegin.inc"
 /*!
@@ -40,7 +44,7 @@
   \class TempFile
   \brief Class responsible for creating and deleting temporary files
 */
-TempFile::TempFile() {
+TempFile::TempFile(): fd(-1) {
 }
 
 TempFile::~TempFile() {
@@ -58,10 +62,37 @@ QString TempFile::create(const QString & ext) {
 	return path;
 }
 
+/*!
+  \brief Create a new temporary file that is only kept in memory
+
+  Where the platform supports it the file is an anonymous memory file,
+  reachable through the returned path while this object holds it, so the
+  content never touches the disk. Otherwise this is the same as create().
+  \param ext The extention of the temporary file, if it ends up on disk
+  \returns Path of the new temporary file
+*/
+QString TempFile::createInMemory(const QString & ext) {
+	remove();
+#if defined(Q_OS_LINUX) && defined(SYS_memfd_create)
+	fd = syscall(SYS_memfd_create, "wktemp", 0);
+	if (fd != -1) {
+		path = "/proc/self/fd/"+QString::number(fd);
+		return path;
+	}
+#endif
+	return create(ext);
+}
+
 /*!
   \brief Remove the temporary file hold by this object it it exists
 */
 void TempFile::remove() {
+#ifdef Q_OS_LINUX
+	if (fd != -1) {
+		::close(fd);
+		fd = -1;
+	} else
+#endif
 	if (!path.isEmpty())
 		QFile::remove(path);
 	path="";
@@ -33,10 +33,12 @@
 class DLL_LOCAL TempFile {
 private:
 	QString path;
+	int fd;
 public:
 	TempFile();
 	~TempFile();
 	QString create(const QString & ext);
+	QString createInMemory(const QString & ext);
 	void remove();
 };
 
@@ -30,21 +30,8 @@
 
 namespace wkhtmltopdf {
 
-void dumpDefaultTOCStyleSheet(QTextStream & stream, settings::TableOfContent & s) {
-    stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << endl
-		   << "<xsl:stylesheet version=\"2.0\"" << endl
-		   << "                xmlns:xsl=\"http://www.w3.org/1999/XSL/Transform\"" << endl
-		   << "                xmlns:outline=\"http://wkhtmltopdf.org/outline\"" << endl
-		   << "                xmlns=\"http://www.w3.org/1999/xhtml\">" << endl
-		   << "  <xsl:output doctype-public=\"-//W3C//DTD XHTML 1.0 Strict//EN\"" << endl
-	       << "              doctype-system=\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\"" << endl
-		   << "              indent=\"yes\" />" << endl
-		   << "  <xsl:template match=\"outline:outline\">" << endl
-		   << "    <html>" << endl
-		   << "      <head>" << endl
-		   << "        <title>" << s.captionText << "</title>" << endl
-		   << "        <meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\" />" << endl
-		   << "        <style>" << endl
+static void dumpDefaultTOCStyle(QTextStream & stream, const settings::TableOfContent & s) {
+	stream << "        <style>" << endl
 		   << "          h1 {" << endl
 		   << "            text-align: center;" << endl
 		   << "            font-size: 20px;" << endl
@@ -62,8 +49,25 @@ void dumpDefaultTOCStyleSheet(QTextStream & stream, settings::TableOfContent & s
 		   << "          ul {padding-left: 0em;}" << endl
 		   << "          ul ul {padding-left: " << s.indentation << ";}" << endl
 		   << "          a {text-decoration:none; color: black;}" << endl
-		   << "        </style>" << endl
-		   << "      </head>" << endl
+		   << "        </style>" << endl;
+}
+
+void dumpDefaultTOCStyleSheet(QTextStream & stream, settings::TableOfContent & s) {
+    stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << endl
+		   << "<xsl:stylesheet version=\"2.0\"" << endl
+		   << "                xmlns:xsl=\"http://www.w3.org/1999/XSL/Transform\"" << endl
+		   << "                xmlns:outline=\"http://wkhtmltopdf.org/outline\"" << endl
+		   << "                xmlns=\"http://www.w3.org/1999/xhtml\">" << endl
+		   << "  <xsl:output doctype-public=\"-//W3C//DTD XHTML 1.0 Strict//EN\"" << endl
+	       << "              doctype-system=\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\"" << endl
+		   << "              indent=\"yes\" />" << endl
+		   << "  <xsl:template match=\"outline:outline\">" << endl
+		   << "    <html>" << endl
+		   << "      <head>" << endl
+		   << "        <title>" << s.captionText << "</title>" << endl
+		   << "        <meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\" />" << endl;
+	dumpDefaultTOCStyle(stream, s);
+	stream << "      </head>" << endl
 		   << "      <body>" << endl
 		   << "        <h1>" << s.captionText << "</h1>" << endl
 		   << "        <ul><xsl:apply-templates select=\"outline:item/outline:item\"/></ul>" << endl
@@ -96,4 +100,53 @@ void dumpDefaultTOCStyleSheet(QTextStream & stream, settings::TableOfContent & s
 		   << "</xsl:stylesheet>" << endl;
 }
 
+#ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+void OutlinePrivate::dumpDefaultTOCChildren(QTextStream & stream, const QList<OutlineItem *> & items, const settings::TableOfContent & s, int level) const {
+	foreach (OutlineItem * item, items) {
+		for (int i=0; i < level; ++i) stream << "  ";
+		stream << "<li>";
+		if (!item->value.isEmpty()) {
+			stream << "<div><a";
+			if (s.forwardLinks)
+				stream << " href=\"" << escape(item->anchor) << "\"";
+			stream << " name=\"" << escape(item->tocAnchor) << "\">" << escape(item->value) << "</a>"
+				   << "<span> " << (item->page + prefixSum[item->document] + settings.pageOffset) << " </span></div>";
+		}
+		stream << "<ul>" << endl;
+		dumpDefaultTOCChildren(stream, item->children, s, level+1);
+		for (int i=0; i < level; ++i) stream << "  ";
+		stream << "</ul></li>" << endl;
+	}
+}
+
+/*!
+  \brief Write the table of content the default style sheet would produce from the outline
+
+  This is the same html as running dumpDefaultTOCStyleSheet over dump, without
+  going through XSLT.
+  \param stream The stream to write the html to
+  \param s The table of content settings to use
+*/
+void Outline::dumpDefaultTOC(QTextStream & stream, const settings::TableOfContent & s) const {
+	d->buildPrefixSum();
+	stream << "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Strict//EN\" "
+		   << "\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">" << endl
+		   << "<html xmlns=\"http://www.w3.org/1999/xhtml\">" << endl
+		   << "      <head>" << endl
+		   << "        <title>" << escape(s.captionText) << "</title>" << endl
+		   << "        <meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\" />" << endl;
+	dumpDefaultTOCStyle(stream, s);
+	stream << "      </head>" << endl
+		   << "      <body>" << endl
+		   << "        <h1>" << escape(s.captionText) << "</h1>" << endl
+		   << "        <ul>" << endl;
+	foreach (OutlineItem * document, d->documentOutlines)
+		d->dumpDefaultTOCChildren(stream, document->children, s, 5);
+	stream << "        </ul>" << endl
+		   << "      </body>" << endl
+		   << "</html>" << endl;
+}
+
+#endif //__EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+
 }
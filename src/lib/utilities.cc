@@ -24,6 +24,7 @@
 #endif
 #endif
 
+#include "converter.hh"
 #include "utilities.hh"
 #include <QDebug>
 #include <QTextStream>
@@ -157,7 +158,13 @@ int handleError(bool success, int errorCode) {
 	QHash<int, int> ce;
 	ce[404] = 2;
 	ce[401] = 3;
-	if (errorCode) {
+	if (errorCode == wkhtmltopdf::Converter::CanceledErrorCode) {
+		fprintf(stderr, "Exit with code %d, due to the conversion being canceled\n", 4);
+		return 4;
+	} else if (errorCode == wkhtmltopdf::Converter::DeadlineErrorCode) {
+		fprintf(stderr, "Exit with code %d, due to the conversion exceeding its deadline\n", 5);
+		return 5;
+	} else if (errorCode) {
 		int c = EXIT_FAILURE;
 		if (ce.contains(errorCode)) c = ce[errorCode];
 		const char * m = "";
@@ -0,0 +1,127 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2014 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "batchjob.hh"
+#include <QCoreApplication>
+#include <cstdio>
+#include <wkhtmltox/utilities.hh>
+
+using namespace wkhtmltopdf::settings;
+using namespace wkhtmltopdf;
+
+/*!
+  \class BatchJob
+  \brief A conversion of a single line read with --read-args-from-stdin
+
+  Several jobs can be converting at the same time in the event loop.
+*/
+
+/*!
+  \brief Set up the conversion of a line
+  \param l The number of the line, used when reporting the result
+  \param g The global settings of the line
+  \param o The objects of the line
+  \param quiet Do not report progress
+*/
+BatchJob::BatchJob(int l, const PdfGlobal & g, const QList<PdfObject> & o, bool quiet):
+	line(l), done(false), success(false), globalSettings(g),
+	converter(globalSettings), feedback(quiet, converter), time(0) {
+	foreach (const PdfObject & object, o)
+		converter.addResource(object);
+	connect(&converter, SIGNAL(finished(bool)), this, SLOT(finished(bool)));
+}
+
+/*!
+  \brief Begin the conversion, done is set once it has finished
+*/
+void BatchJob::start() {
+	timer.start();
+	converter.beginConvertion();
+}
+
+void BatchJob::finished(bool ok) {
+	time = timer.elapsed();
+	success = ok;
+	done = true;
+}
+
+/*!
+  \brief Write out the result of the finished conversion
+  \returns The exit code a single invocation converting the line would have had
+*/
+int BatchJob::report() {
+	int code = handleError(success, converter.httpErrorCode());
+	fprintf(stderr, "Line %d: exit code %d, http error code %d, %lld ms\n",
+			line, code, converter.httpErrorCode(), (long long)time);
+	return code;
+}
+
+/*!
+  \class StdinReader
+  \brief Read the lines of stdin on a thread of its own
+
+  Waiting for the next line would otherwise hold up the event loop, and with
+  it the conversions that are already running.
+*/
+
+StdinReader::StdinReader(): end(false) {}
+
+/*!
+  \brief Take the next line read, if there is one
+  \param line Set to the line
+  \returns False if no line is ready yet
+*/
+bool StdinReader::next(QByteArray & line) {
+	QMutexLocker l(&mutex);
+	if (lines.isEmpty()) return false;
+	line = lines.takeFirst();
+	return true;
+}
+
+/*!
+  \brief Is there a line ready to be taken
+*/
+bool StdinReader::ready() const {
+	QMutexLocker l(&mutex);
+	return !lines.isEmpty();
+}
+
+/*!
+  \brief Have all lines been read and taken
+*/
+bool StdinReader::exhausted() const {
+	QMutexLocker l(&mutex);
+	return end && lines.isEmpty();
+}
+
+void StdinReader::run() {
+	char buff[20400];
+	forever {
+		bool more = fgets(buff,20398,stdin) != NULL;
+		{
+			QMutexLocker l(&mutex);
+			if (more) lines.push_back(QByteArray(buff));
+			else end = true;
+		}
+		//Wake up the event loop of the main thread, which this object lives in
+		QCoreApplication::postEvent(this, new QEvent(QEvent::User));
+		if (!more) break;
+	}
+}
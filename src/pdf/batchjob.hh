@@ -0,0 +1,66 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2014 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __BATCHJOB_HH__
+#define __BATCHJOB_HH__
+#include "progressfeedback.hh"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <wkhtmltox/pdfconverter.hh>
+#include <wkhtmltox/pdfsettings.hh>
+
+class BatchJob: public QObject {
+	Q_OBJECT
+public:
+	BatchJob(int line, const wkhtmltopdf::settings::PdfGlobal & globalSettings,
+			 const QList<wkhtmltopdf::settings::PdfObject> & objectSettings, bool quiet);
+	void start();
+	int report();
+
+	int line;
+	bool done;
+	bool success;
+private:
+	wkhtmltopdf::settings::PdfGlobal globalSettings;
+	wkhtmltopdf::PdfConverter converter;
+	wkhtmltopdf::ProgressFeedback feedback;
+	QElapsedTimer timer;
+	qint64 time;
+private slots:
+	void finished(bool ok);
+};
+
+class StdinReader: public QThread {
+	Q_OBJECT
+public:
+	StdinReader();
+	bool next(QByteArray & line);
+	bool ready() const;
+	bool exhausted() const;
+protected:
+	void run();
+private:
+	mutable QMutex mutex;
+	QList<QByteArray> lines;
+	bool end;
+};
+
+#endif //__BATCHJOB_HH__
@@ -59,5 +59,7 @@ contains(DEFINES, QT_SHARED) {
 }
 
 #Application part
+HEADERS += batchjob.hh
+
 SOURCES += wkhtmltopdf.cc pdfarguments.cc pdfcommandlineparser.cc \
-           pdfdocparts.cc
+           pdfdocparts.cc batchjob.cc
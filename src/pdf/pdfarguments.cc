@@ -166,6 +166,10 @@ struct BookFunc {
 */
 PdfCommandLineParser::PdfCommandLineParser(PdfGlobal & s, QList<PdfObject> & ps):
 	readArgsFromStdin(false),
+	jobs(1),
+	serverWorkers(0),
+	serverMaxJobs(0),
+	serverMaxMemory(0),
 	globalSettings(s),
 	pageSettings(ps) {
 	section("Global Options");
@@ -191,6 +195,11 @@ PdfCommandLineParser::PdfCommandLineParser(PdfGlobal & s, QList<PdfObject> & ps)
  	addarg("title", 0, "The title of the generated pdf file (The title of the first document is used if not specified)", new QStrSetter(s.documentTitle,"text"));
 
 	addarg("read-args-from-stdin", 0, "Read command line arguments from stdin", new ConstSetter<bool>(readArgsFromStdin, true) );
+	addarg("jobs", 0, "Number of lines read with --read-args-from-stdin to convert at the same time", new IntSetter(jobs, "number") );
+	addarg("server", 0, "Run the conversions sent to a unix socket", new QStrSetter(server, "path") );
+	addarg("server-workers", 0, "Number of worker processes serving --server", new IntSetter(serverWorkers, "number") );
+	addarg("server-max-jobs", 0, "Replace a server worker after it has run this many jobs", new IntSetter(serverMaxJobs, "number") );
+	addarg("server-max-memory", 0, "Replace a server worker once it uses more than this many megabytes", new IntSetter(serverMaxMemory, "number") );
 
 	extended(true);
  	qthack(false);
@@ -214,6 +223,10 @@ PdfCommandLineParser::PdfCommandLineParser(PdfGlobal & s, QList<PdfObject> & ps)
 	addarg("image-dpi", 0, "When embedding images scale them down to this dpi", new IntSetter(s.imageDPI, "integer"));
 
     addarg("no-pdf-compression", 0 , "Do not use lossless compression on pdf objects", new ConstSetter<bool>(s.useCompression,false));
+	addarg("release-spooled-pages", 0, "Free every page, header and footer as soon as it has been printed, to bound memory usage on large documents. Links from later headers and footers to released pages are dropped", new ConstSetter<bool>(s.releaseSpooledPages,true));
+	addarg("keep-spooled-pages", 0, "Keep all pages in memory until the whole document has been printed", new ConstSetter<bool>(s.releaseSpooledPages,false));
+	addarg("downscale-images", 0, "Scale jpeg and png images down when they are downloaded, so they are no larger than --image-dpi allows on the paper. Only images wider than the page change size in the layout", new ConstSetter<bool>(s.downscaleImages,true));
+	addarg("no-downscale-images", 0, "Keep downloaded images at their full size until they are printed", new ConstSetter<bool>(s.downscaleImages,false));
 
 #ifdef Q_WS_MACX
 	addarg("native-format-printer", 0 , "Use the native Mac OS X PDF printer to produce a PDF with selectable text. Note: This printer breaks some advanced features of wkhtmltopdf. Use at your own risk.", new ConstSetter<bool>(s.useNativeFormatPrinter,true));
@@ -294,6 +307,8 @@ PdfCommandLineParser::PdfCommandLineParser(PdfGlobal & s, QList<PdfObject> & ps)
  	addarg("header-html",0,"Adds a html header", new QStrSetter(od.header.htmlUrl,"url"));
 
 	addarg("replace",0, "Replace [name] with value in header and footer (repeatable)", new MapSetter<>(od.replacements, "name", "value"));
+	addarg("template-header-footer",0,"Load the html header and footer only once and fill in the variables for every page", new ConstSetter<bool>(od.templateHeaderFooter,true));
+	addarg("no-template-header-footer",0,"Load the html header and footer once for every page", new ConstSetter<bool>(od.templateHeaderFooter,false));
 
 	section("TOC Options");
 	mode(toc);
@@ -53,6 +53,7 @@ void PdfCommandLineParser::manpage(FILE * fd) const {
 #endif
 	outputPageSizes(o);
 	outputArgsFromStdin(o);
+	outputServerDoc(o);
  	outputPageBreakDoc(o);
  	outputContact(o);
  	outputAuthors(o);
@@ -76,6 +77,7 @@ void PdfCommandLineParser::usage(FILE * fd, bool extended) const {
 	if (extended) {
 		outputPageSizes(o);
 		outputArgsFromStdin(o);
+		outputServerDoc(o);
 		outputProxyDoc(o);
 		outputHeaderFooterDoc(o);
 		outputOutlineDoc(o);
@@ -106,6 +108,7 @@ void PdfCommandLineParser::readme(FILE * fd, bool html) const {
  	outputPageBreakDoc(o);
 	outputPageSizes(o);
 	outputArgsFromStdin(o);
+	outputServerDoc(o);
 	outputStaticProblems(o);
 	outputCompilation(o);
 	outputInstallation(o);
@@ -140,8 +143,11 @@ void PdfCommandLineParser::readme(FILE * fd, bool html) const {
  * Parse command line arguments, and set settings accordingly.
  * \param argc the number of command line arguments
  * \param argv a NULL terminated list with the arguments
+ * \param fromStdin the arguments are a line read from stdin, errors in it do
+ * not exit the program
+ * \return false if the arguments were invalid and fromStdin is set
  */
-void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fromStdin) {
+bool PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fromStdin) {
 	bool defaultMode = false;
 	int arg=1;
 
@@ -150,10 +156,10 @@ void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fro
 	//Parse global options
 	for (;arg < argc;++arg) {
 		if (argv[arg][0] != '-' || argv[arg][1] == '\0' || defaultMode) break;
-		parseArg(global | page, argc, argv, defaultMode, arg, (char *)&def);
+		if (!parseArg(global | page, argc, argv, defaultMode, arg, (char *)&def, !fromStdin)) return false;
 	}
 
-	if (readArgsFromStdin && !fromStdin) return;
+	if ((readArgsFromStdin || !server.isEmpty()) && !fromStdin) return true;
 
 	//Parse page options
 	while (arg < argc-1) {
@@ -164,8 +170,7 @@ void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fro
 			++arg;
 			if (arg >= argc-1) {
 				fprintf(stderr, "You need to specify a input file to cover\n\n");
-				usage(stderr, false);
-				exit(1);
+				return argumentError(!fromStdin);
 			}
 			ps.page = QString::fromLocal8Bit(argv[arg]);
 
@@ -186,8 +191,7 @@ void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fro
 				++arg;
 				if (arg >= argc-1) {
 					fprintf(stderr, "You need to specify a input file to page\n\n");
-					usage(stderr, false);
-					exit(1);
+					return argumentError(!fromStdin);
 				}
 			}
 			QByteArray a(argv[arg]);
@@ -196,14 +200,14 @@ void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fro
 		}
 		for (;arg < argc;++arg) {
 			if (argv[arg][0] != '-' || argv[arg][1] == '\0' || defaultMode) break;
-			parseArg(sections, argc, argv, defaultMode, arg, (char*)&ps);
+			if (!parseArg(sections, argc, argv, defaultMode, arg, (char*)&ps, !fromStdin)) return false;
 		}
 	}
 
 	if (pageSettings.size() == 0 || argc < 2) {
 		fprintf(stderr, "You need to specify atleast one input file, and exactly one output file\nUse - for stdin or stdout\n\n");
-		usage(stderr, false);
-		exit(1);
+		return argumentError(!fromStdin);
 	}
 	globalSettings.out = QString::fromLocal8Bit(argv[argc-1]);
+	return true;
 }
@@ -30,6 +30,11 @@ public:
 	const static int page = 2;
 	const static int toc = 4;
 	bool readArgsFromStdin;
+	int jobs;
+	QString server;
+	int serverWorkers;
+	int serverMaxJobs;
+	int serverMaxMemory;
 	wkhtmltopdf::settings::PdfGlobal & globalSettings;
 	QList<wkhtmltopdf::settings::PdfObject> & pageSettings;
 
@@ -62,7 +67,7 @@ public:
 	virtual void manpage(FILE * fd) const;
 	virtual void readme(FILE * fd, bool html) const;
 
-	void parseArguments(int argc, const char ** argv, bool fromStdin=false);
+	bool parseArguments(int argc, const char ** argv, bool fromStdin=false);
 
 	virtual char * mapAddress(char * d, char * ns) const {
 		const char * _od = reinterpret_cast<const char *>(&od);
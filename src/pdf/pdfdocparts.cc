@@ -220,6 +220,12 @@ void PdfCommandLineParser::outputHeaderFooterDoc(Outputter * o) const {
 		);
 	o->paragraph("As can be seen from the example, the arguments are sent to the header/footer "
 				 "html documents in get fashion.");
+	o->paragraph("Loading the header and footer documents once for every page is slow for "
+				 "large documents. With --template-header-footer they are loaded only once per "
+				 "page object, and for every page the variables are substituted into the loaded "
+				 "document: [name] sequences in the markup are replaced, and the text of elements "
+				 "with a class named after a variable is set to its value. Scripts are only run "
+				 "once, when the first page is loaded.");
 	o->endSection();
 }
 
@@ -322,6 +328,12 @@ void PdfCommandLineParser::outputArgsFromStdin(Outputter * o) const {
 	o->verbatim("echo \"http://doc.trolltech.com/4.5/qapplication.html qapplication.pdf\" >> cmds\n"
 				"echo \"cover google.com http://en.wikipedia.org/wiki/Qt_(toolkit) qt.pdf\" >> cmds\n"
 				"wkhtmltopdf --read-args-from-stdin --book < cmds\n");
+	o->paragraph("A failing line, also one with invalid arguments, does not stop the lines after it. "
+				 "The result of every line is "
+				 "written to stderr, as its exit code, http error code and the time it took, and "
+				 "wkhtmltopdf exits with an error if any line failed. Use --jobs to convert "
+				 "several lines at the same time, which pays off when the pages spend most of "
+				 "their time waiting for the network or javascript.");
 	o->endSection();
 }
 
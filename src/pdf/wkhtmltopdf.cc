@@ -18,6 +18,8 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
 
+#include "batchjob.hh"
+#include "conversionserver.hh"
 #include "pdfcommandlineparser.hh"
 #include "progressfeedback.hh"
 #include <QCommonStyle>
@@ -112,6 +114,45 @@ void parseString(char * buff, int &nargc, char **nargv) {
 	nargv[nargc]=NULL;
 }
 
+/*!
+  \brief Run the pdf conversions sent to --server
+*/
+class PdfConversionServer: public ConversionServer {
+public:
+	PdfConversionServer(const QString & path, const PdfGlobal & d, MyLooksStyle * s):
+		ConversionServer(path), defaults(d), style(s) {}
+protected:
+	PdfGlobal defaults;
+	MyLooksStyle * style;
+
+	virtual void convert(const ServerJob & job) {
+		PdfGlobal globalSettings = defaults;
+		//The output goes back over the socket
+		globalSettings.out.clear();
+		globalSettings.dumpOutline.clear();
+		QList<PdfObject> objectSettings;
+		bool ok = apply(globalSettings, job.global);
+		foreach (const ServerSettings & values, job.objects) {
+			objectSettings.push_back(PdfObject());
+			ok = ok && apply(objectSettings.back(), values);
+		}
+		if (!ok) {
+			finish(false, 0);
+			return;
+		}
+
+		PdfConverter converter(globalSettings);
+		QObject::connect(&converter, SIGNAL(producingForms(bool)), style, SLOT(producingForms(bool)));
+		QObject::connect(&converter, SIGNAL(checkboxSvgChanged(const QString &)), style, SLOT(setCheckboxSvg(const QString &)));
+		QObject::connect(&converter, SIGNAL(checkboxCheckedSvgChanged(const QString &)), style, SLOT(setCheckboxCheckedSvg(const QString &)));
+		QObject::connect(&converter, SIGNAL(radiobuttonSvgChanged(const QString &)), style, SLOT(setRadioButtonSvg(const QString &)));
+		QObject::connect(&converter, SIGNAL(radiobuttonCheckedSvgChanged(const QString &)), style, SLOT(setRadioButtonCheckedSvg(const QString &)));
+		foreach (const PdfObject & object, objectSettings)
+			converter.addResource(object);
+		run(converter);
+	}
+};
+
 int main(int argc, char * argv[]) {
 	//This will store all our settings
 	PdfGlobal globalSettings;
@@ -125,6 +166,13 @@ int main(int argc, char * argv[]) {
 	//Parse the arguments
 	parser.parseArguments(argc, (const char**)argv);
 
+	//The server is set up, and its workers forked, before Qt is
+	int listener = -1;
+	if (!parser.server.isEmpty()) {
+		listener = ConversionServer::start(parser.server, parser.serverWorkers);
+		if (listener == -1) return EXIT_FAILURE;
+	}
+
 	//Construct QApplication required for printing
 	bool use_graphics=true;
 #if defined(Q_WS_X11) || defined(Q_WS_MACX)
@@ -137,33 +185,63 @@ int main(int argc, char * argv[]) {
 	MyLooksStyle * style = new MyLooksStyle();
 	a.setStyle(style);
 
+	if (listener != -1) {
+		PdfConversionServer server(parser.server, globalSettings, style);
+		server.setWorkers(parser.serverWorkers, parser.serverMaxJobs, parser.serverMaxMemory);
+		return server.exec(listener);
+	}
+
 	if (parser.readArgsFromStdin) {
-		char buff[20400];
+		QByteArray buff;
 		char *nargv[1000];
 		nargv[0] = argv[0];
 		for (int i=0; i < argc; ++i) nargv[i] = argv[i];
-		while (fgets(buff,20398,stdin)) {
-			int nargc=argc;
-			parseString(buff,nargc,nargv);
-
-			PdfGlobal globalSettings;
-			QList<PdfObject> objectSettings;
-			//Create a command line parser to parse commandline arguments
-			PdfCommandLineParser parser(globalSettings, objectSettings);
-			//Setup default values in settings
-			//parser.loadDefaults();
-			//Parse the arguments
-			parser.parseArguments(nargc, (const char**)nargv, true);
-
-			PdfConverter converter(globalSettings);
-			ProgressFeedback feedback(globalSettings.quiet, converter);
-			foreach (const PdfObject & object, objectSettings)
-				converter.addResource(object);
-
-			if (!converter.convert())
-				exit(EXIT_FAILURE);
+		int jobs = qMax(parser.jobs, 1);
+		int line = 0;
+		bool failed = false;
+		QList<BatchJob *> running;
+		StdinReader reader;
+		reader.start();
+		forever {
+			//Keep up to jobs lines converting
+			while (running.size() < jobs && reader.next(buff)) {
+				++line;
+				int nargc=argc;
+				parseString(buff.data(),nargc,nargv);
+
+				PdfGlobal globalSettings;
+				QList<PdfObject> objectSettings;
+				//Create a command line parser to parse commandline arguments
+				PdfCommandLineParser parser(globalSettings, objectSettings);
+				//Setup default values in settings
+				//parser.loadDefaults();
+				//Parse the arguments, a line with invalid arguments fails on its own
+				if (!parser.parseArguments(nargc, (const char**)nargv, true)) {
+					fprintf(stderr, "Line %d: exit code %d, invalid arguments\n", line, EXIT_FAILURE);
+					failed = true;
+					continue;
+				}
+
+				BatchJob * job = new BatchJob(line, globalSettings, objectSettings, globalSettings.quiet || jobs > 1);
+				running.push_back(job);
+				job->start();
+			}
+
+			for (int i=0; i < running.size();) {
+				if (!running[i]->done) {
+					++i;
+					continue;
+				}
+				if (running[i]->report() != EXIT_SUCCESS) failed = true;
+				delete running.takeAt(i);
+			}
+			if (running.isEmpty() && reader.exhausted()) break;
+			//Wait for a conversion to finish or for the next line
+			if (running.size() >= jobs || !reader.ready())
+				qApp->processEvents(QEventLoop::WaitForMoreEvents | QEventLoop::AllEvents);
 		}
-		exit(EXIT_SUCCESS);
+		reader.wait();
+		exit(failed?EXIT_FAILURE:EXIT_SUCCESS);
 	}
 	//Create the actual page converter to convert the pages
 	PdfConverter converter(globalSettings);
@@ -91,35 +91,47 @@ void CommandLineParserBase::version(FILE * fd) const {
 	delete o;
 }
 
-void CommandLineParserBase::parseArg(int sections, const int argc, const char ** argv, bool & defaultMode, int & arg, char * page) {
+/*!
+  Report an invalid command line. When exitOnError is set, as it is for the
+  real command line, the usage is printed and the program exits; otherwise
+  false is returned so the caller can give up on just this command line.
+  \param exitOnError Exit the program on the error
+*/
+bool CommandLineParserBase::argumentError(bool exitOnError) const {
+	if (!exitOnError) return false;
+	usage(stderr, false);
+	exit(1);
+}
+
+/*!
+  Parse a single switch with its arguments.
+  \return false if the switch was invalid and exitOnError is not set
+*/
+bool CommandLineParserBase::parseArg(int sections, const int argc, const char ** argv, bool & defaultMode, int & arg, char * page, bool exitOnError) {
 	if (argv[arg][1] == '-') { //We have a long style argument
 		//After an -- apperas in the argument list all that follows is interpreted as default arguments
 		if (argv[arg][2] == '0') {
 			defaultMode=true;
-			return;
+			return true;
 		}
 		//Try to find a handler for this long switch
 		QHash<QString, ArgHandler*>::iterator j = longToHandler.find(argv[arg]+2);
 		if (j == longToHandler.end()) { //Ups that argument did not exist
 			fprintf(stderr, "Unknown long argument %s\n\n", argv[arg]);
-			usage(stderr, false);
-			exit(1);
+			return argumentError(exitOnError);
 		}
 		if (!(j.value()->section & sections)) {
 			fprintf(stderr, "%s specified in incorrect location\n\n", argv[arg]);
-			usage(stderr, false);
-			exit(1);
+			return argumentError(exitOnError);
 		}
 		//Check to see if there is enough arguments to the switch
 		if (argc-arg < j.value()->argn.size()+1) {
 			fprintf(stderr, "Not enough arguments parsed to %s\n\n", argv[arg]);
-			usage(stderr, false);
-			exit(1);
+			return argumentError(exitOnError);
 		}
 		if (!(*(j.value()))(argv+arg+1, *this, page)) {
 			fprintf(stderr, "Invalid argument(s) parsed to %s\n\n", argv[arg]);
-			usage(stderr, false);
-			exit(1);
+			return argumentError(exitOnError);
 		}
 #ifndef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 		if (j.value()->qthack)
@@ -134,25 +146,21 @@ void CommandLineParserBase::parseArg(int sections, const int argc, const char **
 			//If the short argument is invalid print usage information and exit
 			if (k == shortToHandler.end()) {
 				fprintf(stderr, "Unknown switch -%c\n\n", argv[c][j]);
-				usage(stderr, false);
-				exit(1);
+				return argumentError(exitOnError);
 			}
 
 			if (!(k.value()->section & sections)) {
 				fprintf(stderr, "-%c specified in incorrect location\n\n", argv[c][j]);
-				usage(stderr, false);
-				exit(1);
+				return argumentError(exitOnError);
 			}
 			//Check to see if there is enough arguments to the switch
 			if (argc-arg < k.value()->argn.size()+1) {
 				fprintf(stderr, "Not enough arguments parsed to -%c\n\n", argv[c][j]);
-				usage(stderr, false);
-				exit(1);
+				return argumentError(exitOnError);
 			}
 			if (!(*(k.value()))(argv+arg+1, *this, page)) {
 				fprintf(stderr, "Invalid argument(s) parsed to -%c\n\n", argv[c][j]);
-				usage(stderr, false);
-				exit(1);
+				return argumentError(exitOnError);
 			}
 #ifndef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
  			if (k.value()->qthack)
@@ -162,4 +170,5 @@ void CommandLineParserBase::parseArg(int sections, const int argc, const char **
 			arg += k.value()->argn.size();
 		}
 	}
+	return true;
 }
@@ -71,12 +71,14 @@ public:
 	void outputAuthors(Outputter * o) const;
 	void outputStaticProblems(Outputter * o) const;
 	void outputProxyDoc(Outputter * o) const;
+	void outputServerDoc(Outputter * o) const;
 
 	//commandlineparserbase.cc
 	void outputSwitches(Outputter * o, bool extended, bool doc) const;
 	virtual char * mapAddress(char * d, char *) const {return d;}
 	virtual void version(FILE * fd) const;
-	void parseArg(int sections, const int argc, const char ** argv, bool & defaultMode, int & arg, char * page);
+	bool argumentError(bool exitOnError) const;
+	bool parseArg(int sections, const int argc, const char ** argv, bool & defaultMode, int & arg, char * page, bool exitOnError=true);
 
 	virtual QString appName() const = 0;
 	virtual void usage(FILE * fd, bool extended) const = 0;
@@ -163,6 +163,9 @@ void CommandLineParserBase::addGlobalLoadArgs(LoadGlobal & s) {
 	qthack(false);
 
     addarg("cookie-jar", 0, "Read and write cookies from and to the supplied cookie jar file", new QStrSetter(s.cookieJar, "path") );
+	addarg("memory-cache-size", 0, "Keep up to this many megabytes of downloaded resources in memory, shared by all conversions of the process. Requests carrying credentials, that is an authorization or cookie header, cookies, custom headers or a username, are never cached", new IntSetter(s.memoryCacheSize, "mb"));
+	addarg("job-timeout", 0, "Fail the conversion if it takes longer than some milliseconds", new IntSetter(s.jobTimeout, "msec"));
+	addarg("phase-timeout", 0, "Fail the conversion if loading, building the table of content or printing takes longer than some milliseconds, printing is checked between pages", new IntSetter(s.phaseTimeout, "msec"));
 }
 
 void CommandLineParserBase::addWebArgs(Web & s) {
@@ -202,6 +205,15 @@ void CommandLineParserBase::addPageLoadArgs(LoadPage & s) {
 
 	addarg("javascript-delay",0,"Wait some milliseconds for javascript finish", new IntSetter(s.jsdelay,"msec"));
 	addarg("window-status",0,"Wait until window.status is equal to this string before rendering page", new QStrSetter(s.windowStatus, "windowStatus"));
+	addarg("network-idle",0,"Render the page once no requests have been in flight for some milliseconds, instead of waiting for --javascript-delay", new IntSetter(s.networkIdle,"msec"));
+	addarg("wait-for-ready",0,"Render the page once javascript calls window.wkhtmltopdfReady(), instead of waiting for --javascript-delay", new ConstSetter<bool>(s.waitForReady, true));
+	addarg("no-wait-for-ready",0,"Do not wait for javascript to call window.wkhtmltopdfReady()", new ConstSetter<bool>(s.waitForReady, false));
+	addarg("max-load-wait",0,"Wait at most some milliseconds for --network-idle or --wait-for-ready", new IntSetter(s.maxLoadWait,"msec"));
+	addarg("resource-timeout",0,"Abort requests for resources taking longer than some milliseconds", new IntSetter(s.resourceTimeout,"msec"));
+	addarg("max-host-connections",0,"Send at most this many requests to a host at the same time, stylesheets and fonts are sent before images", new IntSetter(s.hostConnections,"number"));
+	addarg("http-pipelining",0,"Allow http pipelining of requests", new ConstSetter<bool>(s.httpPipelining, true));
+	addarg("no-http-pipelining",0,"Do not allow http pipelining of requests", new ConstSetter<bool>(s.httpPipelining, false));
+	addarg("max-image-size",0,"Scale downloaded jpeg and png images down to at most this many pixels wide and high. Images the document gives no size are laid out at the smaller size", new IntSetter(s.maxImageSize,"pixels"));
 
 	addarg("zoom",0,"Use this zoom factor", new FloatSetter(s.zoomFactor,"float",1.0));
 	addarg("cookie",0,"Set an additional cookie (repeatable)", new MapSetter<>(s.cookies, "name", "value"));
@@ -213,6 +225,8 @@ void CommandLineParserBase::addPageLoadArgs(LoadPage & s) {
 	addarg("allow", 0, "Allow the file or files from the specified folder to be loaded (repeatable)", new StringListSetter(s.allowed,"path"));
 
 	addarg("cache-dir", 0, "Web cache directory", new QStrSetter(s.cacheDir,"path"));
+	addarg("cache-immutable-host", 0, "Use cached resources from this host without revalidating them (repeatable)", new StringListSetter(s.immutableHosts,"host"));
+	addarg("map-url", 0, "Serve urls starting with prefix from files in the directory, without using the network (repeatable)", new MapSetter<>(s.urlMappings, "prefix", "path"));
 
 	addarg("debug-javascript", 0,"Show javascript debugging output", new ConstSetter<bool>(s.debugJavascript, true));
 	addarg("no-debug-javascript", 0,"Do not show javascript debugging output", new ConstSetter<bool>(s.debugJavascript, false));
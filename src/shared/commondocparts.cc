@@ -107,3 +107,38 @@ void CommandLineParserBase::outputProxyDoc(Outputter * o) const {
 				"None\n");
 	o->endSection();
 }
+
+/*!
+  Output documentation about running as a server
+  \param o The outputter to output to
+*/
+void CommandLineParserBase::outputServerDoc(Outputter * o) const {
+	o->beginSection("Running As A Server");
+	o->paragraph(
+		"When --server is given "+appName()+" does not convert anything itself, but "
+		"listens on the given unix socket and runs the conversions sent to it, so the "
+		"cost of starting up is only paid once. The global options given on the "
+		"command line are used as defaults for every conversion.");
+	o->paragraph(
+		"A conversion is sent as a line for every setting, in the form name=value, "
+		"using the setting names of the C API. A line only containing \"object\" starts "
+		"the settings of a new object, and an empty line runs the conversion. "
+		"The server answers with the lines below, where every data line is directly "
+		"followed by that many bytes of the output. The output is always sent back this "
+		"way, so the out, dumpOutline, cookieJar and cacheDir settings are refused.");
+	o->verbatim(
+		"warning <message>\n"
+		"error <message>\n"
+		"data <size>\n"
+		"done <success> <http error code>\n");
+	o->paragraph("More conversions can be sent over the same connection. The "
+		"scripts/conversion-client.py script in the source tree is a small client.");
+	o->paragraph(
+		"On unix --server-workers forks the given number of worker processes, which "
+		"take the connections in turn, a worker only taking one while it is idle. "
+		"Since WebKit never gives memory back, a worker is replaced by a fresh one after --server-max-jobs "
+		"conversions or once it uses more than --server-max-memory megabytes. A worker "
+		"closes its connection after the conversion it retires on, so clients should "
+		"connect again when the connection is closed.");
+	o->endSection();
+}
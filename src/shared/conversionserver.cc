@@ -0,0 +1,329 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2014 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "conversionserver.hh"
+#include <QFile>
+#include <cstdio>
+#include <cstdlib>
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+namespace wkhtmltopdf {
+/*!
+  \file conversionserver.hh
+  \brief Define the ConversionServer class
+*/
+
+/*!
+  \class ConversionServer
+  \brief Run conversions for clients connecting to a unix socket, in a single process
+
+  A client sends one or more jobs over the connection. A job is a line for every
+  setting, of the form name=value, using the names of the settings in the C API.
+  Settings are global until a line only containing "object", after which they
+  apply to a new object. An empty line ends the job.
+
+  For every job the server answers with "warning <message>" and "error <message>"
+  lines, the output in blocks of "data <size>" lines followed by size bytes, and
+  finally a "done <success> <http error code>" line.
+
+  On unix the socket is set up by start, before Qt is, and with workers that many
+  processes are forked right after. Every worker sets up Qt on its own, so they share
+  no event dispatcher or other state, and only accepts a connection while it is idle,
+  so a client never waits on a busy worker or is dropped by a retiring one. A worker
+  is replaced by a fresh one after it has run a number of jobs or grown too large, as
+  the memory used by WebKit is never given back.
+*/
+
+/*!
+  \brief Construct a server
+  \param p The path of the unix socket to listen on
+*/
+ConversionServer::ConversionServer(const QString & p):
+	path(p), socket(0), listener(-1), server(0), workers(0), maxJobs(0), maxMemory(0) {}
+
+#ifdef Q_OS_UNIX
+/*!
+  \brief Listen on a unix socket
+  \param path The path of the socket
+  \returns The listening socket, or -1 after reporting why it could not be set up
+*/
+static int listenOn(const QString & path) {
+	QByteArray name = QFile::encodeName(path);
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (size_t(name.size()) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "The socket path %s is too long\n", name.constData());
+		return -1;
+	}
+	strcpy(addr.sun_path, name.constData());
+
+	//Only a socket nobody is listening on any more is left over from an earlier server
+	int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		fprintf(stderr, "Could not listen on %s: %s\n", name.constData(), strerror(errno));
+		return -1;
+	}
+	if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0) {
+		::close(fd);
+		fprintf(stderr, "Another server is already listening on %s\n", name.constData());
+		return -1;
+	}
+	if (errno == ECONNREFUSED) unlink(name.constData());
+	::close(fd);
+
+	fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1 || ::bind(fd, (sockaddr *)&addr, sizeof(addr)) == -1 || ::listen(fd, SOMAXCONN) == -1) {
+		fprintf(stderr, "Could not listen on %s: %s\n", name.constData(), strerror(errno));
+		if (fd != -1) ::close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+}
+#endif
+
+/*!
+  \brief Set up the socket of a server and start its workers, before Qt is set up
+
+  Without workers the socket is returned at once. With workers the calling process
+  stays in start to supervise them, and start returns the socket in every worker it
+  forks. Qt must not be set up before, as the workers would share its event
+  dispatcher and the connections it has open.
+  \param path The path of the unix socket to listen on
+  \param workers The number of worker processes, 0 to serve jobs in this process
+  \returns The socket to pass to exec, or -1 if the server could not be started
+*/
+int ConversionServer::start(const QString & path, int workers) {
+#ifdef Q_OS_UNIX
+	int fd = listenOn(path);
+	if (fd == -1 || workers <= 0) return fd;
+
+	//Keep the workers running, starting a new one whenever one retires
+	int running = 0;
+	forever {
+		while (running < workers) {
+			pid_t pid = fork();
+			if (pid == 0) return fd;
+			if (pid == -1) {
+				fprintf(stderr, "Could not start a worker: %s\n", strerror(errno));
+				if (running == 0) return -1;
+				break;
+			}
+			++running;
+		}
+		if (wait(NULL) > 0) --running;
+	}
+#else
+	Q_UNUSED(path);
+	Q_UNUSED(workers);
+	//Without unix sockets the server listens with a QLocalServer in exec
+	return 0;
+#endif
+}
+
+/*!
+  \brief Serve the jobs in worker processes, only supported on unix
+  \param w The number of worker processes, 0 to serve jobs in this process
+  \param j The number of jobs after which a worker is replaced, 0 for no limit
+  \param m The resident memory in megabytes after which a worker is replaced, 0 for no limit
+*/
+void ConversionServer::setWorkers(int w, int j, int m) {
+	workers = w;
+	maxJobs = j;
+	maxMemory = m;
+}
+
+/*!
+  \brief Serve jobs until the process is killed or the worker retires
+  \param l The socket returned by start
+  \returns The exit code of the process
+*/
+int ConversionServer::exec(int l) {
+	listener = l;
+#ifndef Q_OS_UNIX
+	//Only a socket nobody is listening on any more is left over from an earlier server
+	QLocalSocket probe;
+	probe.connectToServer(path);
+	if (probe.waitForConnected(1000)) {
+		fprintf(stderr, "Another server is already listening on %s\n", path.toLocal8Bit().constData());
+		return EXIT_FAILURE;
+	}
+	if (probe.error() == QLocalSocket::ConnectionRefusedError)
+		QLocalServer::removeServer(path);
+	QLocalServer localServer;
+	if (!localServer.listen(path)) {
+		fprintf(stderr, "Could not listen on %s: %s\n",
+				path.toLocal8Bit().constData(), localServer.errorString().toLocal8Bit().constData());
+		return EXIT_FAILURE;
+	}
+	server = &localServer;
+#endif
+	int jobs = 0;
+	//The conversions run their own event loop, so the sockets are used blocking
+	forever {
+		socket = nextConnection();
+		if (!socket) continue;
+		ServerJob job;
+		bool done = false;
+		while (!done && readJob(job)) {
+			convert(job);
+			job = ServerJob();
+			done = retire(++jobs);
+		}
+		socket->disconnectFromServer();
+		delete socket;
+		socket = 0;
+		if (done) return EXIT_SUCCESS;
+	}
+}
+
+/*!
+  \brief Wait for the next client to connect
+  \returns The connection, or 0 if accepting it failed
+*/
+QLocalSocket * ConversionServer::nextConnection() {
+#ifdef Q_OS_UNIX
+	//Accepted only while idle, so the connections left wait for an idle worker
+	int fd = ::accept(listener, NULL, NULL);
+	if (fd == -1) return 0;
+	QLocalSocket * s = new QLocalSocket();
+	if (s->setSocketDescriptor(fd)) return s;
+	delete s;
+	::close(fd);
+	return 0;
+#else
+	if (!server->waitForNewConnection(-1)) return 0;
+	return server->nextPendingConnection();
+#endif
+}
+
+/*!
+  \brief Should this worker be replaced by a fresh one
+  \param jobs The number of jobs run by the worker
+*/
+bool ConversionServer::retire(int jobs) {
+	if (workers <= 0) return false;
+	if (maxJobs > 0 && jobs >= maxJobs) return true;
+	if (maxMemory <= 0) return false;
+	//The second number is the resident size in pages
+	QFile statm("/proc/self/statm");
+	if (!statm.open(QIODevice::ReadOnly)) return false;
+	QList<QByteArray> fields = statm.readAll().split(' ');
+	if (fields.size() < 2) return false;
+#ifdef Q_OS_UNIX
+	return fields[1].toLongLong() * sysconf(_SC_PAGESIZE) > qint64(maxMemory) * 1024 * 1024;
+#else
+	return false;
+#endif
+}
+
+/*!
+  \brief Read the next job from the client
+  \param job The job to fill in
+  \returns False when the client disconnected
+*/
+bool ConversionServer::readJob(ServerJob & job) {
+	ServerSettings * current = &job.global;
+	bool empty = true;
+	forever {
+		while (!socket->canReadLine())
+			if (!socket->waitForReadyRead(-1)) return false;
+		QString line = QString::fromUtf8(socket->readLine());
+		while (line.endsWith('\n') || line.endsWith('\r')) line.chop(1);
+		if (line.isEmpty()) {
+			if (empty) continue;
+			return true;
+		}
+		empty = false;
+		if (line == "object") {
+			job.objects.push_back(ServerSettings());
+			current = &job.objects.back();
+			continue;
+		}
+		int eq = line.indexOf('=');
+		if (eq == -1)
+			current->push_back(qMakePair(line, QString()));
+		else
+			current->push_back(qMakePair(line.left(eq), line.mid(eq+1)));
+	}
+}
+
+/*!
+  \brief May a job change a setting
+
+  The output is always sent back over the socket, so settings that
+  would make the server write files with its own rights are refused.
+  \param name The name of the setting
+*/
+bool ConversionServer::allowed(const QString & name) {
+	static QStringList refused = QStringList() << "out" << "dumpOutline" << "cookieJar" << "cacheDir";
+	return !refused.contains(name.section('.', -1));
+}
+
+void ConversionServer::write(const QByteArray & data) {
+	socket->write(data);
+	while (socket->bytesToWrite() > 0)
+		if (!socket->waitForBytesWritten(-1)) break;
+}
+
+/*!
+  \brief Run a conversion of a job, and report the result to the client
+  \param converter The converter set up with the settings of the job
+*/
+void ConversionServer::run(Converter & converter) {
+	connect(&converter, SIGNAL(warning(const QString &)), this, SLOT(warning(const QString &)));
+	connect(&converter, SIGNAL(error(const QString &)), this, SLOT(error(const QString &)));
+	connect(&converter, SIGNAL(outputChunk(const QByteArray &)), this, SLOT(outputChunk(const QByteArray &)));
+	converter.setStreamOutput(true);
+	bool success = converter.convert();
+	finish(success, converter.httpErrorCode());
+}
+
+/*!
+  \brief Tell the client the job is done
+  \param success Did the conversion succeed
+  \param httpErrorCode The http error code of the conversion
+*/
+void ConversionServer::finish(bool success, int httpErrorCode) {
+	write("done " + QByteArray::number(success?1:0) + " " + QByteArray::number(httpErrorCode) + "\n");
+}
+
+void ConversionServer::warning(const QString & message) {
+	write("warning " + QString(message).replace('\n', ' ').toUtf8() + "\n");
+}
+
+void ConversionServer::error(const QString & message) {
+	write("error " + QString(message).replace('\n', ' ').toUtf8() + "\n");
+}
+
+void ConversionServer::outputChunk(const QByteArray & data) {
+	write("data " + QByteArray::number(data.size()) + "\n");
+	write(data);
+}
+
+}
@@ -0,0 +1,95 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2014 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __CONVERSIONSERVER_HH__
+#define __CONVERSIONSERVER_HH__
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPair>
+#include <QStringList>
+#include <wkhtmltox/converter.hh>
+namespace wkhtmltopdf {
+
+typedef QList<QPair<QString, QString> > ServerSettings;
+
+/*! \brief A conversion requested from the server */
+struct ServerJob {
+	//! Global settings of the conversion
+	ServerSettings global;
+	//! Settings of every object of the conversion
+	QList<ServerSettings> objects;
+};
+
+class ConversionServer: public QObject {
+	Q_OBJECT
+public:
+	ConversionServer(const QString & path);
+	virtual ~ConversionServer() {}
+	static int start(const QString & path, int workers);
+	void setWorkers(int workers, int maxJobs, int maxMemory);
+	int exec(int listener);
+protected:
+	/*!
+	  \brief Run a job received by the server
+	  Implementations apply the settings, and call run or finish
+	*/
+	virtual void convert(const ServerJob & job) = 0;
+	void run(Converter & converter);
+	void finish(bool success, int httpErrorCode);
+	static bool allowed(const QString & name);
+
+	/*!
+	  \brief Apply the settings of a job to a settings object
+	  \returns False, after reporting the error, if a setting could not be set
+	*/
+	template <typename T>
+	bool apply(T & settings, const ServerSettings & values) {
+		typedef QPair<QString, QString> value_t;
+		foreach (const value_t & value, values) {
+			if (!allowed(value.first)) {
+				error("The setting " + value.first + " can not be set by a job");
+				return false;
+			}
+			if (settings.set(value.first.toUtf8().constData(), value.second)) continue;
+			error("Could not set " + value.first + " to " + value.second);
+			return false;
+		}
+		return true;
+	}
+private:
+	QString path;
+	QLocalSocket * socket;
+	int listener;
+	QLocalServer * server;
+	int workers;
+	int maxJobs;
+	int maxMemory;
+	QLocalSocket * nextConnection();
+	bool retire(int jobs);
+	bool readJob(ServerJob & job);
+	void write(const QByteArray & data);
+public slots:
+	void warning(const QString & message);
+	void error(const QString & message);
+	void outputChunk(const QByteArray & data);
+};
+
+}
+#endif //__CONVERSIONSERVER_HH__
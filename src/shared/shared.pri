@@ -15,9 +15,9 @@
 # You should have received a copy of the GNU Lesser General Public License
 # along with wkhtmltopdf.  If not, see <http:#www.gnu.org/licenses/>.
 
-HEADERS +=  ../shared/progressfeedback.hh
+HEADERS +=  ../shared/progressfeedback.hh ../shared/conversionserver.hh
 
 SOURCES += ../shared/outputter.cc ../shared/manoutputter.cc ../shared/htmloutputter.cc \
            ../shared/textoutputter.cc ../shared/arghandler.cc ../shared/commondocparts.cc \
  	   ../shared/commandlineparserbase.cc ../shared/commonarguments.cc \
-	   ../shared/progressfeedback.cc
+	   ../shared/progressfeedback.cc ../shared/conversionserver.cc